@@ -52,6 +52,29 @@ void FallbackPackageTest::cycle()
 
     // The cycle should have been detected and filePath should take a not infinite time
     QTRY_COMPARE_WITH_TIMEOUT(m_fallbackPkg.filePath("ui", QStringLiteral("otherfile.qml")), m_pkg.filePath("ui", QStringLiteral("otherfile.qml")), 1000);
+    // misses go through the whole chain
+    QVERIFY(m_pkg.filePath("ui", QStringLiteral("doesnotexist.qml")).isEmpty());
+    QVERIFY(m_fallbackPkg.filePath("ui", QStringLiteral("doesnotexist.qml")).isEmpty());
+}
+
+void FallbackPackageTest::sameRoot()
+{
+    // another package of the same root can't be a fallback, it would only repeat the lookups
+    KPackage::Package package = KPackage::PackageLoader::self()->loadPackage(QStringLiteral("KPackage/Generic"));
+    package.addFileDefinition("mainscript", QStringLiteral("ui/main.qml"));
+    package.setPath(m_packagePath);
+    QVERIFY(package.isValid());
+    package.setFallbackPackage(m_pkg);
+    QVERIFY(!package.fallbackPackage().isValid());
+
+    // nor a chain leading back to the root of the package
+    KPackage::Package chained = KPackage::PackageLoader::self()->loadPackage(QStringLiteral("KPackage/Generic"));
+    chained.addFileDefinition("mainscript", QStringLiteral("ui/main.qml"));
+    chained.setPath(m_fallPackagePath);
+    chained.setFallbackPackage(m_pkg);
+    QVERIFY(!chained.fallbackPackage().isValid());
+    QCOMPARE(chained.filePath("ui", QStringLiteral("otherfile.qml")), m_fallbackPkg.filePath("ui", QStringLiteral("otherfile.qml")));
+    QVERIFY(chained.filePath("ui", QStringLiteral("doesnotexist.qml")).isEmpty());
 }
 
 QTEST_MAIN(FallbackPackageTest)
@@ -21,6 +21,7 @@ private Q_SLOTS:
     void beforeFallback();
     void afterFallback();
     void cycle();
+    void sameRoot();
 
 private:
     KPackage::Package m_pkg;
@@ -0,0 +1,298 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "packagebenchmark.h"
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <kzip.h>
+
+#include "packagejob.h"
+#include "packageloader.h"
+#include "packagestructure.h"
+
+// Run with e.g. "packagebenchmark -o results.xml,xml" for results to compare across releases,
+// the "benchmark" target of the build directory does so.
+
+static const QList<int> s_sizes{10, 100, 1000};
+// how deep the contents/code tree of the packages goes
+static const int s_depth = 6;
+
+static QString benchmarkFormat(int count)
+{
+    return QStringLiteral("KPackage/Benchmark%1").arg(count);
+}
+
+class BenchmarkStructure : public KPackage::PackageStructure
+{
+    Q_OBJECT
+
+public:
+    BenchmarkStructure(const QString &packageRoot, QObject *parent)
+        : KPackage::PackageStructure(parent)
+        , m_packageRoot(packageRoot)
+    {
+        // like the structures of the library, initPackage only depends on the root
+        setPackageTemplateEnabled(true);
+    }
+
+    void initPackage(KPackage::Package *package) override
+    {
+        KPackage::PackageStructure::initPackage(package);
+        package->setDefaultPackageRoot(m_packageRoot);
+        package->addDirectoryDefinition("ui", QStringLiteral("ui"));
+        package->addFileDefinition("mainscript", QStringLiteral("ui/main.qml"));
+        package->setRequired("mainscript", true);
+        package->addDirectoryDefinition("scripts", QStringLiteral("code"));
+        package->addDirectoryDefinition("images", QStringLiteral("images"));
+    }
+
+private:
+    const QString m_packageRoot;
+};
+
+static void writeFile(const QString &path, const QByteArray &contents)
+{
+    QDir().mkpath(QFileInfo(path).path());
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(contents);
+}
+
+static bool waitFor(KJob *job)
+{
+    QSignalSpy spy(job, &KJob::finished);
+    return spy.wait(30000) && job->error() == KJob::NoError;
+}
+
+void PackageBenchmark::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    qputenv("XDG_DATA_DIRS", "/not/valid");
+
+    m_dataDir = QDir(QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QStringLiteral("/kpackagebenchmark"));
+    m_dataDir.removeRecursively();
+    // the package indexes, manifests and hashes of previous runs
+    QDir(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QStringLiteral("/kpackage")).removeRecursively();
+    QVERIFY(m_dataDir.mkpath(QStringLiteral(".")));
+
+    for (int count : s_sizes) {
+        const QString root = packageRoot(count);
+        for (int i = 0; i < count; ++i) {
+            const QString pluginId = QStringLiteral("org.kde.benchmark.%1").arg(i);
+            createPackage(root + QLatin1Char('/') + pluginId, pluginId, benchmarkFormat(count), QStringLiteral("1.0"));
+        }
+        KPackage::PackageLoader::self()->addKnownPackageStructure(benchmarkFormat(count), new BenchmarkStructure(root, this));
+    }
+
+    m_installRoot = m_dataDir.filePath(QStringLiteral("installed"));
+    KPackage::PackageLoader::self()->addKnownPackageStructure(QStringLiteral("KPackage/BenchmarkInstall"), new BenchmarkStructure(m_installRoot, this));
+}
+
+void PackageBenchmark::cleanupTestCase()
+{
+    m_dataDir.removeRecursively();
+}
+
+QString PackageBenchmark::packageRoot(int count) const
+{
+    return m_dataDir.filePath(QStringLiteral("root%1").arg(count));
+}
+
+void PackageBenchmark::createPackage(const QString &path, const QString &pluginId, const QString &format, const QString &version)
+{
+    const QJsonObject metadata{
+        {QStringLiteral("KPackageStructure"), format},
+        {QStringLiteral("KPlugin"),
+         QJsonObject{{QStringLiteral("Id"), pluginId}, {QStringLiteral("Name"), pluginId}, {QStringLiteral("Version"), version}}},
+    };
+    writeFile(path + QStringLiteral("/metadata.json"), QJsonDocument(metadata).toJson());
+    writeFile(path + QStringLiteral("/contents/ui/main.qml"), QByteArrayLiteral("import QtQuick\nItem {}\n"));
+    QString code = path + QStringLiteral("/contents/code");
+    for (int level = 0; level < s_depth; ++level) {
+        code += QStringLiteral("/level%1").arg(level);
+        writeFile(code + QStringLiteral("/file.js"), QByteArray(1024, 'x'));
+    }
+    writeFile(path + QStringLiteral("/contents/images/image.svg"), QByteArray(16 * 1024, 'y'));
+}
+
+QString PackageBenchmark::createArchive(const QString &pluginId, const QString &version)
+{
+    const QString source = m_dataDir.filePath(QStringLiteral("archive-source/") + pluginId);
+    QDir(source).removeRecursively();
+    createPackage(source, pluginId, QStringLiteral("KPackage/BenchmarkInstall"), version);
+
+    const QString archivePath = m_dataDir.filePath(pluginId + QLatin1Char('-') + version + QStringLiteral(".zip"));
+    KZip archive(archivePath);
+    if (!archive.open(QIODevice::WriteOnly)) {
+        return QString();
+    }
+    archive.addLocalDirectory(source, QStringLiteral("."));
+    archive.close();
+    return archivePath;
+}
+
+void PackageBenchmark::addSizes()
+{
+    QTest::addColumn<int>("count");
+    for (int count : s_sizes) {
+        QTest::addRow("%d packages", count) << count;
+    }
+}
+
+void PackageBenchmark::listPackagesCold_data()
+{
+    addSizes();
+}
+
+void PackageBenchmark::listPackagesCold()
+{
+    QFETCH(int, count);
+    // nothing is cached yet, neither in memory nor in the package index
+    QBENCHMARK_ONCE {
+        QCOMPARE(KPackage::PackageLoader::self()->listPackages(benchmarkFormat(count), packageRoot(count)).size(), count);
+    }
+}
+
+void PackageBenchmark::listPackagesWarm_data()
+{
+    addSizes();
+}
+
+void PackageBenchmark::listPackagesWarm()
+{
+    QFETCH(int, count);
+    KPackage::PackageLoader::self()->listPackages(benchmarkFormat(count), packageRoot(count));
+    QBENCHMARK {
+        KPackage::PackageLoader::self()->listPackages(benchmarkFormat(count), packageRoot(count));
+    }
+}
+
+void PackageBenchmark::listKPackages_data()
+{
+    addSizes();
+}
+
+void PackageBenchmark::listKPackages()
+{
+    QFETCH(int, count);
+    QBENCHMARK {
+        QCOMPARE(KPackage::PackageLoader::self()->listKPackages(benchmarkFormat(count), packageRoot(count)).size(), count);
+    }
+}
+
+void PackageBenchmark::loadPackageById_data()
+{
+    addSizes();
+}
+
+void PackageBenchmark::loadPackageById()
+{
+    QFETCH(int, count);
+    const QString pluginId = QStringLiteral("org.kde.benchmark.%1").arg(count - 1);
+    QBENCHMARK {
+        QVERIFY(KPackage::PackageLoader::self()->loadPackage(benchmarkFormat(count), pluginId).isValid());
+    }
+}
+
+void PackageBenchmark::filePathHit_data()
+{
+    addSizes();
+}
+
+void PackageBenchmark::filePathHit()
+{
+    QFETCH(int, count);
+    KPackage::Package package = KPackage::PackageLoader::self()->loadPackage(benchmarkFormat(count), QStringLiteral("org.kde.benchmark.0"));
+    const QString deepFile = QStringLiteral("level0/level1/level2/level3/level4/level5/file.js");
+    QBENCHMARK {
+        QVERIFY(!package.filePath("mainscript").isEmpty());
+        QVERIFY(!package.filePath("scripts", deepFile).isEmpty());
+    }
+}
+
+void PackageBenchmark::filePathMiss_data()
+{
+    addSizes();
+}
+
+void PackageBenchmark::filePathMiss()
+{
+    QFETCH(int, count);
+    KPackage::Package package = KPackage::PackageLoader::self()->loadPackage(benchmarkFormat(count), QStringLiteral("org.kde.benchmark.0"));
+    QBENCHMARK {
+        QVERIFY(package.filePath("scripts", QStringLiteral("missing.js")).isEmpty());
+        QVERIFY(package.filePath("configmodel").isEmpty());
+    }
+}
+
+void PackageBenchmark::filePathFallbackChain()
+{
+    // each package falls back to the next one, only the last one has the file
+    const int chainLength = 8;
+    const QString format = benchmarkFormat(s_sizes.last());
+    KPackage::Package package;
+    for (int i = chainLength - 1; i >= 0; --i) {
+        KPackage::Package link = KPackage::PackageLoader::self()->loadPackage(format, QStringLiteral("org.kde.benchmark.%1").arg(i));
+        QVERIFY(link.isValid());
+        if (i == chainLength - 1) {
+            writeFile(link.path() + QStringLiteral("contents/images/fallback.svg"), QByteArrayLiteral("<svg/>"));
+        } else {
+            link.setFallbackPackage(package);
+        }
+        package = link;
+    }
+    QBENCHMARK {
+        QVERIFY(!package.filePath("images", QStringLiteral("fallback.svg")).isEmpty());
+    }
+}
+
+void PackageBenchmark::cryptographicHashCold()
+{
+    KPackage::Package package = KPackage::PackageLoader::self()->loadPackage(benchmarkFormat(10), QStringLiteral("org.kde.benchmark.0"));
+    const QString hashCache = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QStringLiteral("/kpackage/hash");
+    QBENCHMARK {
+        QDir(hashCache).removeRecursively();
+        QVERIFY(!package.cryptographicHash(QCryptographicHash::Sha1).isEmpty());
+    }
+}
+
+void PackageBenchmark::cryptographicHashWarm()
+{
+    KPackage::Package package = KPackage::PackageLoader::self()->loadPackage(benchmarkFormat(10), QStringLiteral("org.kde.benchmark.0"));
+    package.cryptographicHash(QCryptographicHash::Sha1);
+    QBENCHMARK {
+        QVERIFY(!package.cryptographicHash(QCryptographicHash::Sha1).isEmpty());
+    }
+}
+
+void PackageBenchmark::installArchive()
+{
+    const QString archive = createArchive(QStringLiteral("org.kde.benchmark.installed"), QStringLiteral("1.0"));
+    QVERIFY(!archive.isEmpty());
+    QBENCHMARK {
+        QVERIFY(waitFor(KPackage::PackageJob::install(QStringLiteral("KPackage/BenchmarkInstall"), archive, m_installRoot)));
+        QVERIFY(waitFor(KPackage::PackageJob::uninstall(QStringLiteral("KPackage/BenchmarkInstall"), QStringLiteral("org.kde.benchmark.installed"), m_installRoot)));
+    }
+}
+
+void PackageBenchmark::updateArchive()
+{
+    const QString oldVersion = createArchive(QStringLiteral("org.kde.benchmark.updated"), QStringLiteral("1.0"));
+    const QString newVersion = createArchive(QStringLiteral("org.kde.benchmark.updated"), QStringLiteral("2.0"));
+    QVERIFY(waitFor(KPackage::PackageJob::install(QStringLiteral("KPackage/BenchmarkInstall"), oldVersion, m_installRoot)));
+    // an update needs a newer version, so there is only one to measure
+    QBENCHMARK_ONCE {
+        QVERIFY(waitFor(KPackage::PackageJob::update(QStringLiteral("KPackage/BenchmarkInstall"), newVersion, m_installRoot)));
+    }
+}
+
+QTEST_MAIN(PackageBenchmark)
+
+#include "packagebenchmark.moc"
+#include "moc_packagebenchmark.cpp"
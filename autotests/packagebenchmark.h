@@ -0,0 +1,50 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef PACKAGEBENCHMARK_H
+#define PACKAGEBENCHMARK_H
+
+#include <QDir>
+#include <QTest>
+
+class PackageBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void listPackagesCold_data();
+    void listPackagesCold();
+    void listPackagesWarm_data();
+    void listPackagesWarm();
+    void listKPackages_data();
+    void listKPackages();
+    void loadPackageById_data();
+    void loadPackageById();
+    void filePathHit_data();
+    void filePathHit();
+    void filePathMiss_data();
+    void filePathMiss();
+    void filePathFallbackChain();
+    void cryptographicHashCold();
+    void cryptographicHashWarm();
+    void installArchive();
+    void updateArchive();
+
+private:
+    void addSizes();
+    // @return the root with @p count packages of the format benchmarkFormat(count)
+    QString packageRoot(int count) const;
+    void createPackage(const QString &path, const QString &pluginId, const QString &format, const QString &version);
+    QString createArchive(const QString &pluginId, const QString &version);
+
+    QDir m_dataDir;
+    QString m_installRoot;
+};
+
+#endif
@@ -9,8 +9,11 @@
 
 #include <KLocalizedString>
 #include <QDebug>
+#include <QSignalSpy>
+#include <QTemporaryDir>
 
 #include "packageloader.h"
+#include "packageprefetchjob.h"
 #include "packagestructure.h"
 #include "private/utils.h"
 
@@ -99,6 +102,33 @@ public:
     }
 };
 
+class CountingStructure : public KPackage::PackageStructure
+{
+    Q_OBJECT
+public:
+    explicit CountingStructure(bool sharedTemplate)
+    {
+        setPackageTemplateEnabled(sharedTemplate);
+    }
+    void initPackage(KPackage::Package *package) override
+    {
+        ++initCount;
+        package->addDirectoryDefinition("ui", QStringLiteral("ui/"));
+        package->addFileDefinition("mainscript", QStringLiteral("ui/main.qml"));
+        package->setRequired("mainscript", true);
+    }
+    void invalidate()
+    {
+        invalidatePackageTemplate();
+    }
+    void enableTemplate(bool enabled)
+    {
+        setPackageTemplateEnabled(enabled);
+    }
+
+    int initCount = 0;
+};
+
 void PackageStructureTest::initTestCase()
 {
     m_packagePath = QFINDTESTDATA("data/testpackage");
@@ -322,6 +352,94 @@ void PackageStructureTest::customContent()
     QCOMPARE(p.filePath("customcontentfile"), QString());
 }
 
+void PackageStructureTest::sharedTemplate()
+{
+    CountingStructure structure(true);
+    KPackage::Package first(&structure);
+    KPackage::Package second(&structure);
+    QCOMPARE(structure.initCount, 1);
+    QCOMPARE(first.files(), second.files());
+    QVERIFY(first.isRequired("mainscript"));
+
+    // packages stay independent from each other and from the template
+    first.addFileDefinition("nonsense", QStringLiteral("foobar"));
+    first.setRequired("mainscript", false);
+    QVERIFY(!second.files().contains("nonsense"));
+    QVERIFY(second.isRequired("mainscript"));
+    KPackage::Package third(&structure);
+    QVERIFY(!third.files().contains("nonsense"));
+    QVERIFY(third.isRequired("mainscript"));
+
+    second.setPath(m_packagePath);
+    QVERIFY(second.isValid());
+    QCOMPARE(second.filePath("mainscript"), QFileInfo(m_packagePath + QLatin1String("/contents/ui/main.qml")).canonicalFilePath());
+
+    structure.invalidate();
+    KPackage::Package fourth(&structure);
+    QCOMPARE(structure.initCount, 2);
+    QVERIFY(fourth.isRequired("mainscript"));
+
+    structure.enableTemplate(false);
+    KPackage::Package fifth(&structure);
+    KPackage::Package sixth(&structure);
+    QCOMPARE(structure.initCount, 4);
+    QCOMPARE(fifth.files(), fourth.files());
+}
+
+void PackageStructureTest::noTemplateByDefault()
+{
+    // structures which didn't ask for a template see each of their packages
+    CountingStructure structure(false);
+    KPackage::Package first(&structure);
+    KPackage::Package second(&structure);
+    QCOMPARE(structure.initCount, 2);
+    QCOMPARE(first.files(), second.files());
+    QVERIFY(second.isRequired("mainscript"));
+}
+
+void PackageStructureTest::cachedMisses()
+{
+    KPackage::Package p = KPackage::PackageLoader::self()->loadPackage(QStringLiteral("KPackage/GenericQML"));
+    p.setPath(m_packagePath);
+    QVERIFY(p.isValid());
+
+    QCOMPARE(p.filePath("ui", QStringLiteral("doesnotexist.qml")), QString());
+    QCOMPARE(p.filePath("ui", QStringLiteral("doesnotexist.qml")), QString());
+    QCOMPARE(p.filePath("ui", QStringLiteral("otherfile.qml")), QFileInfo(m_packagePath + QLatin1String("/contents/ui/otherfile.qml")).canonicalFilePath());
+
+    // changing the definitions drops the remembered misses
+    p.addFileDefinition("alternatives", QStringLiteral("ui/doesnotexist.qml"));
+    QCOMPARE(p.filePath("alternatives"), QString());
+    p.addFileDefinition("alternatives", QStringLiteral("ui/main.qml"));
+    QCOMPARE(p.filePath("alternatives"), QFileInfo(m_packagePath + QLatin1String("/contents/ui/main.qml")).canonicalFilePath());
+
+    p.removeDefinition("alternatives");
+    QCOMPARE(p.filePath("alternatives"), QString());
+}
+
+void PackageStructureTest::prefetch()
+{
+    QTemporaryDir dir;
+    QVERIFY(QDir(dir.path()).mkpath(QStringLiteral("contents/ui")));
+    QFile mainScript(dir.filePath(QStringLiteral("contents/ui/main.qml")));
+    QVERIFY(mainScript.open(QIODevice::WriteOnly));
+    mainScript.close();
+    const QString mainScriptPath = QFileInfo(mainScript).canonicalFilePath();
+
+    KPackage::Package p = KPackage::PackageLoader::self()->loadPackage(QStringLiteral("KPackage/Generic"));
+    p.addFileDefinition("mainscript", QStringLiteral("ui/main.qml"));
+    p.setPath(dir.path());
+    KPackage::PackagePrefetchJob *job = p.prefetch({"mainscript"});
+    QCOMPARE(job->packages().count(), 1);
+    QSignalSpy spy(job, &KJob::result);
+    QVERIFY(spy.wait());
+
+    // answered out of what the job found out, the file is gone by now
+    QVERIFY(mainScript.remove());
+    QCOMPARE(p.filePath("mainscript"), mainScriptPath);
+    QVERIFY(p.isValid());
+}
+
 QTEST_MAIN(PackageStructureTest)
 
 #include "moc_packagestructuretest.cpp"
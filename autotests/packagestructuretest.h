@@ -31,6 +31,10 @@ private Q_SLOTS:
     void required();
     void mimeTypes();
     void customContent();
+    void sharedTemplate();
+    void noTemplateByDefault();
+    void cachedMisses();
+    void prefetch();
 
 private:
     KPackage::Package ps;
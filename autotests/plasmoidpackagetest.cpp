@@ -8,17 +8,25 @@
 #include "../src/kpackage/config-package.h"
 
 #include <KJob>
+#include <QDateTime>
 #include <QDir>
 #include <QFile>
 #include <QSignalSpy>
 #include <QStandardPaths>
 #include <kzip.h>
 
+#include <optional>
+
+#ifdef Q_OS_UNIX
+#include <utime.h>
+#endif
+
 #include <QDebug>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <qtestcase.h>
 
+#include "packagebatchjob.h"
 #include "packagejob.h"
 #include "packageloader.h"
 #include "private/utils.h"
@@ -47,6 +55,16 @@ void PlasmoidPackageTest::cleanup()
     QDir(m_packageRoot).removeRecursively();
 }
 
+// @return the permissions a directory created inside @p root gets
+static QFile::Permissions newDirectoryPermissions(const QString &root)
+{
+    const QString reference = root + QStringLiteral("/permissions-reference");
+    QDir().mkdir(reference);
+    const QFile::Permissions permissions = QFileInfo(reference).permissions();
+    QDir().rmdir(reference);
+    return permissions;
+}
+
 void PlasmoidPackageTest::createTestPackage(const QString &packageName, const QString &version)
 {
     qDebug() << "Create test package" << m_packageRoot;
@@ -169,6 +187,59 @@ void PlasmoidPackageTest::isValid()
     p.setPath(m_packageRoot + '/' + m_package);
     QVERIFY(p.isValid());
     QCOMPARE(p.cryptographicHash(QCryptographicHash::Sha1), QByteArrayLiteral("468c7934dfa635986a85e3364363b1f39d157cd5"));
+    // the second time the result comes from the cache
+    QCOMPARE(p.cryptographicHash(QCryptographicHash::Sha1), QByteArrayLiteral("468c7934dfa635986a85e3364363b1f39d157cd5"));
+
+    // which doesn't survive a change of the contents
+    QVERIFY(file.open(QIODevice::Append));
+    file.write("// changed\n");
+    file.close();
+    QVERIFY(p.cryptographicHash(QCryptographicHash::Sha1) != QByteArrayLiteral("468c7934dfa635986a85e3364363b1f39d157cd5"));
+}
+
+void PlasmoidPackageTest::verify()
+{
+    createTestPackage(QStringLiteral("verify_package"), QStringLiteral("1.0"));
+    KPackage::Package p(m_defaultPackage);
+    p.setPath(m_packageRoot + "/verify_package");
+    QVERIFY(p.isValid());
+    const QByteArray expectedHash = p.cryptographicHash(QCryptographicHash::Sha1);
+
+    auto job = KPackage::PackageJob::verify(p, expectedHash.toUpper());
+    QSignalSpy spy(job, &KJob::finished);
+    QVERIFY(spy.wait(1000));
+    QCOMPARE(job->error(), int(KJob::NoError));
+    QCOMPARE(job->hash(), expectedHash);
+    QVERIFY(job->totalAmount(KJob::Bytes) > 0);
+    QCOMPARE(job->processedAmount(KJob::Bytes), job->totalAmount(KJob::Bytes));
+
+    job = KPackage::PackageJob::verify(p, QByteArrayLiteral("0123456789abcdef0123456789abcdef01234567"));
+    QSignalSpy mismatchSpy(job, &KJob::finished);
+    QVERIFY(mismatchSpy.wait(1000));
+    QCOMPARE(job->error(), int(KPackage::PackageJob::JobError::PackageHashMismatchError));
+    QCOMPARE(job->hash(), expectedHash);
+
+    // without any cached hash
+    QVERIFY(QDir(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/kpackage/hash").removeRecursively());
+    job = KPackage::PackageJob::verify(p, expectedHash);
+    QSignalSpy coldSpy(job, &KJob::finished);
+    QVERIFY(coldSpy.wait(1000));
+    QCOMPARE(job->error(), int(KJob::NoError));
+    QCOMPARE(job->hash(), expectedHash);
+
+    // a file damaged in place, its size and modification time unchanged, doesn't verify
+    QFile mainScript(m_packageRoot + "/verify_package/contents/ui/main.qml");
+    const QDateTime modified = QFileInfo(mainScript).lastModified();
+    QVERIFY(mainScript.open(QIODevice::ReadWrite));
+    const QByteArray damaged(mainScript.size(), 'x');
+    QCOMPARE(mainScript.write(damaged), damaged.size());
+    QVERIFY(mainScript.setFileTime(modified, QFileDevice::FileModificationTime));
+    mainScript.close();
+    job = KPackage::PackageJob::verify(p, expectedHash);
+    QSignalSpy damagedSpy(job, &KJob::finished);
+    QVERIFY(damagedSpy.wait(1000));
+    QCOMPARE(job->error(), int(KPackage::PackageJob::JobError::PackageHashMismatchError));
+    QVERIFY(job->hash() != expectedHash);
 }
 
 void PlasmoidPackageTest::filePath()
@@ -230,6 +301,24 @@ void PlasmoidPackageTest::entryList()
     QCOMPARE(files.size(), 2);
     QVERIFY(files.contains(QStringLiteral("image-1.svg")));
     QVERIFY(files.contains(QStringLiteral("image-2.svg")));
+
+    // with options the listing is remembered until the package changes, without it is listed again
+    QCOMPARE(p.entryList("images", KPackage::Package::NoEntryListOptions).size(), 2);
+    QFile notes(m_packageRoot + '/' + m_package + "/contents/images/notes.txt");
+    QVERIFY(notes.open(QIODevice::WriteOnly));
+    notes.close();
+    QCOMPARE(p.entryList("images", KPackage::Package::NoEntryListOptions).size(), 2);
+    QCOMPARE(p.entryList("images").size(), 3);
+
+    KPackage::Package reloaded(m_defaultPackage);
+    reloaded.setPath(m_packageRoot + '/' + m_package);
+    QCOMPARE(reloaded.entryList("images").size(), 3);
+    QCOMPARE(reloaded.entryList("images", KPackage::Package::SortByName, 1, 1), QStringList{QStringLiteral("image-2.svg")});
+    reloaded.setMimeTypes("images", {QStringLiteral("image/svg+xml")});
+    QCOMPARE(reloaded.entryList("images", KPackage::Package::FilterByMimeType | KPackage::Package::SortByName),
+             QStringList({QStringLiteral("image-1.svg"), QStringLiteral("image-2.svg")}));
+    reloaded.setMimeTypes("images", {QStringLiteral("text/*")});
+    QCOMPARE(reloaded.entryList("images", KPackage::Package::FilterByMimeType), QStringList{QStringLiteral("notes.txt")});
 }
 
 void PlasmoidPackageTest::createAndInstallPackage()
@@ -272,6 +361,10 @@ void PlasmoidPackageTest::createAndInstallPackage()
 
     // is the package instance usable (ie proper path) after the install job has been completed?
     QCOMPARE(p.path(), QString(QDir(m_packageRoot % "/plasmoid_to_package").canonicalPath() + QLatin1Char('/')));
+    // readable by everybody the package root is, unlike the staging directory it was extracted to
+    QCOMPARE(QFileInfo(m_packageRoot + "/plasmoid_to_package").permissions(), newDirectoryPermissions(m_packageRoot));
+    // the archive got staged in the package root, nothing of it should be left behind
+    QCOMPARE(QDir(m_packageRoot).entryList({QStringLiteral(".kpackage-install-*")}, QDir::Dirs | QDir::Hidden), QStringList());
     cleanupPackage(QStringLiteral("plasmoid_to_package"));
 }
 
@@ -343,10 +436,132 @@ void PlasmoidPackageTest::createAndUpdatePackage()
     });
     QSignalSpy spy2(job2, &KJob::finished);
     QVERIFY(spy2.wait(1000));
+    // the new version got swapped in place of the old one
+    QCOMPARE(KPluginMetaData::fromJsonFile(m_packageRoot + "/plasmoid_to_package/metadata.json").version(), QStringLiteral("1.2"));
+    QCOMPARE(QFileInfo(m_packageRoot + "/plasmoid_to_package").permissions(), newDirectoryPermissions(m_packageRoot));
+
+    // the same for an update from a directory, which gets copied next to the installed version first
+    createTestPackage(QStringLiteral("plasmoid_update_source"), QStringLiteral("1.3"));
+    QFile metadata(m_packageRoot + "/plasmoid_update_source/metadata.json");
+    QVERIFY(metadata.open(QIODevice::ReadOnly));
+    QByteArray json = metadata.readAll();
+    metadata.close();
+    json.replace("plasmoid_update_source", "plasmoid_to_package");
+    QVERIFY(metadata.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    metadata.write(json);
+    metadata.close();
+    KJob *job3 = KPackage::PackageJob::update(m_defaultPackageStructure, m_packageRoot + "/plasmoid_update_source", m_packageRoot);
+    connect(job3, &KJob::finished, [this, job3]() {
+        packageInstalled(job3);
+    });
+    QSignalSpy spy3(job3, &KJob::finished);
+    QVERIFY(spy3.wait(1000));
+    QCOMPARE(KPluginMetaData::fromJsonFile(m_packageRoot + "/plasmoid_to_package/metadata.json").version(), QStringLiteral("1.3"));
+    QCOMPARE(QFileInfo(m_packageRoot + "/plasmoid_to_package").permissions(), newDirectoryPermissions(m_packageRoot));
+    QDir(m_packageRoot + "/plasmoid_update_source").removeRecursively();
 
     cleanupPackage(QStringLiteral("plasmoid_to_package"));
 }
 
+void PlasmoidPackageTest::updateInCustomRoot()
+{
+    // a root of its own, not readable by everybody, the updated package still gets the usual permissions in there
+    const QString customRoot = m_packageRoot + QStringLiteral("/customRoot");
+    QVERIFY(QDir().mkpath(customRoot));
+    QVERIFY(QFile::setPermissions(customRoot, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner | QFile::ReadGroup | QFile::ExeGroup));
+    KPackage::PackageLoader::self()->addKnownPackageStructure(m_defaultPackageStructure, new KPackage::PackageStructure(this));
+
+    createTestPackage(QStringLiteral("custom_root_package"), QStringLiteral("1.0"));
+    auto job = KPackage::PackageJob::install(m_defaultPackageStructure, m_packageRoot + "/custom_root_package", customRoot);
+    QSignalSpy spy(job, &KJob::finished);
+    QVERIFY(spy.wait(1000));
+    QCOMPARE(job->error(), int(KJob::NoError));
+
+    createTestPackage(QStringLiteral("custom_root_package"), QStringLiteral("1.1"));
+    job = KPackage::PackageJob::update(m_defaultPackageStructure, m_packageRoot + "/custom_root_package", customRoot);
+    QSignalSpy updateSpy(job, &KJob::finished);
+    QVERIFY(updateSpy.wait(1000));
+    QCOMPARE(job->error(), int(KJob::NoError));
+
+    const QString packagePath = customRoot + "/custom_root_package";
+    QCOMPARE(KPluginMetaData::fromJsonFile(packagePath + "/metadata.json").version(), QStringLiteral("1.1"));
+    QCOMPARE(QFileInfo(packagePath).permissions(), newDirectoryPermissions(customRoot));
+    QCOMPARE(QFileInfo(packagePath + "/contents/ui").permissions(), newDirectoryPermissions(customRoot));
+    // the old version gets deleted in the background, after that nothing of the update is left in the root
+    QTRY_COMPARE(QDir(customRoot).entryList({QStringLiteral(".kpackage-install-*")}, QDir::Dirs | QDir::Hidden), QStringList());
+}
+
+void PlasmoidPackageTest::batchInstall()
+{
+    createTestPackage(QStringLiteral("batch_package_1"), QStringLiteral("1.0"));
+    createTestPackage(QStringLiteral("batch_package_2"), QStringLiteral("1.0"));
+    const QString batchRoot = m_packageRoot + QStringLiteral("/batchRoot");
+    KPackage::PackageLoader::self()->addKnownPackageStructure(m_defaultPackageStructure, new KPackage::PackageStructure(this));
+
+    const QStringList sources{m_packageRoot + "/batch_package_1", m_packageRoot + "/batch_package_2", m_packageRoot + "/does_not_exist"};
+    auto job = KPackage::PackageBatchJob::install(m_defaultPackageStructure, sources, batchRoot);
+    QSignalSpy packageSpy(job, &KPackage::PackageBatchJob::packageFinished);
+    QSignalSpy spy(job, &KJob::finished);
+    QVERIFY(spy.wait(1000));
+
+    QCOMPARE(packageSpy.count(), 3);
+    QCOMPARE(job->count(), 3);
+    QCOMPARE(job->source(2), m_packageRoot + "/does_not_exist");
+    QCOMPARE(job->packageError(0), int(KJob::NoError));
+    QCOMPARE(job->packageError(1), int(KJob::NoError));
+    QCOMPARE(job->packageError(2), int(KPackage::PackageJob::JobError::PackageFileNotFoundError));
+    // the batch fails with the error of the package which did
+    QCOMPARE(job->error(), int(KPackage::PackageJob::JobError::PackageFileNotFoundError));
+    QCOMPARE(job->package(1).path(), QDir(batchRoot + "/batch_package_2").canonicalPath() + QLatin1Char('/'));
+    QVERIFY(QFile::exists(batchRoot + "/batch_package_1/contents/ui/main.qml"));
+
+    // a job deleted while the indexes of its roots get updated doesn't get called back
+    createTestPackage(QStringLiteral("batch_package_3"), QStringLiteral("1.0"));
+    job = KPackage::PackageBatchJob::install(m_defaultPackageStructure, {m_packageRoot + "/batch_package_3"}, batchRoot);
+    connect(job, &KPackage::PackageBatchJob::packageFinished, job, &QObject::deleteLater);
+    QSignalSpy destroyedSpy(job, &QObject::destroyed);
+    QSignalSpy resultSpy(job, &KJob::result);
+    QVERIFY(destroyedSpy.wait(1000));
+    QTest::qWait(100);
+    QCOMPARE(resultSpy.count(), 0);
+}
+
+void PlasmoidPackageTest::installHiddenPluginId()
+{
+    // would be installed into a hidden directory of the root, where the trash and the staging directories are
+    createTestPackage(QStringLiteral(".hidden_package"), QStringLiteral("1.0"));
+    const QString otherRoot = m_packageRoot + QStringLiteral("/otherRoot");
+    KPackage::PackageLoader::self()->addKnownPackageStructure(m_defaultPackageStructure, new KPackage::PackageStructure(this));
+
+    auto job = KPackage::PackageJob::install(m_defaultPackageStructure, m_packageRoot + "/.hidden_package", otherRoot);
+    QSignalSpy spy(job, &KJob::finished);
+    QVERIFY(spy.wait(1000));
+    QCOMPARE(job->error(), int(KPackage::PackageJob::JobError::PluginIdInvalidError));
+    QVERIFY(!QFile::exists(otherRoot + "/.hidden_package"));
+}
+
+void PlasmoidPackageTest::removeAbandonedStaging()
+{
+#ifdef Q_OS_UNIX
+    createTestPackage(QStringLiteral("plasmoid_to_remove"), QStringLiteral("1.0"));
+    // left behind by an install which crashed two hours ago, and the one of an install still running
+    const QString abandoned = m_packageRoot + "/.kpackage-install-abandoned";
+    const QString running = m_packageRoot + "/.kpackage-install-running";
+    QVERIFY(QDir().mkpath(abandoned + "/package/contents"));
+    QVERIFY(QDir().mkpath(running + "/package"));
+    const time_t longAgo = QDateTime::currentDateTime().addSecs(-2 * 60 * 60).toSecsSinceEpoch();
+    const utimbuf times{longAgo, longAgo};
+    QCOMPARE(::utime(QFile::encodeName(abandoned).constData(), &times), 0);
+
+    // removing a package cleans up its root in the background
+    cleanupPackage(QStringLiteral("plasmoid_to_remove"));
+    QTRY_VERIFY(!QFile::exists(abandoned));
+    QVERIFY(QFile::exists(running));
+#else
+    QSKIP("The modification time of the staging directory can't be set");
+#endif
+}
+
 void PlasmoidPackageTest::uncompressPackageWithSubFolder()
 {
     KPackage::PackageStructure *structure = new KPackage::PackageStructure;
@@ -356,6 +571,34 @@ void PlasmoidPackageTest::uncompressPackageWithSubFolder()
     QCOMPARE(readKPackageType(package.metadata()), "KPackage/CustomContent");
 }
 
+void PlasmoidPackageTest::extractOnDemand()
+{
+    KPackage::PackageStructure *structure = new KPackage::PackageStructure;
+    std::optional<KPackage::Package> package;
+    package.emplace(structure);
+    package->addFileDefinition("mainscript", QStringLiteral("ui/main.qml"));
+    package->addFileDefinition("customcontentfile", QStringLiteral("customcontent/CustomContentFile.qml"));
+    package->setPath(QFINDTESTDATA("data/customcontent.tar.gz"));
+
+    // the metadata is read from the archive, nothing gets extracted for it
+    QCOMPARE(package->metadata().pluginId(), QStringLiteral("org.kde.customcontent"));
+
+    const QString mainScript = package->filePath("mainscript");
+    QVERIFY(mainScript.endsWith(QLatin1String("/contents/ui/main.qml")));
+    QVERIFY(QFile::exists(mainScript));
+    const QString root = mainScript.chopped(QStringLiteral("contents/ui/main.qml").size());
+    QVERIFY(!QFile::exists(root + QLatin1String("contents/customcontent/CustomContentFile.qml")));
+    QCOMPARE(package->filePath("customcontentfile"), root + QLatin1String("contents/customcontent/CustomContentFile.qml"));
+
+    // copies share the extracted files, they go away with the last of them
+    KPackage::Package copy = *package;
+    package.reset();
+    QVERIFY(QFile::exists(mainScript));
+    QCOMPARE(copy.filePath("mainscript"), mainScript);
+    copy = KPackage::Package();
+    QVERIFY(!QFile::exists(mainScript));
+}
+
 void PlasmoidPackageTest::cleanupPackage(const QString &packageName)
 {
     KJob *j = KPackage::PackageJob::uninstall(m_defaultPackageStructure, packageName, m_packageRoot);
@@ -365,6 +608,11 @@ void PlasmoidPackageTest::cleanupPackage(const QString &packageName)
 
     QSignalSpy spy(j, &KJob::finished);
     QVERIFY(spy.wait(1000));
+    QVERIFY(!QFile::exists(m_packageRoot + '/' + packageName));
+    // the package went through the trash, its files get deleted in the background
+    const QDir trash(m_packageRoot + "/.kpackage-trash");
+    QVERIFY(trash.exists());
+    QTRY_VERIFY(trash.entryList(QDir::Dirs | QDir::Hidden | QDir::NoDotAndDotDot).isEmpty());
 }
 
 void PlasmoidPackageTest::packageInstalled(KJob *j)
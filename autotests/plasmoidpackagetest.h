@@ -24,8 +24,14 @@ public Q_SLOTS:
 private Q_SLOTS:
     void createAndInstallPackage();
     void createAndUpdatePackage();
+    void updateInCustomRoot();
+    void batchInstall();
+    void installHiddenPluginId();
+    void removeAbandonedStaging();
     void uncompressPackageWithSubFolder();
+    void extractOnDemand();
     void isValid();
+    void verify();
     void filePath();
     void entryList();
     void testInstallNonExistentPackageStructure();
@@ -9,10 +9,17 @@
 
 #include <KLocalizedString>
 #include <QCoreApplication>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QSignalSpy>
 #include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QThread>
 
 #include "packagejob.h"
+#include "packagelistjob.h"
 #include "packageloader.h"
+#include "packagequery.h"
 #include "packagestructure.h"
 
 #include "config.h"
@@ -30,9 +37,9 @@ void QueryTest::initTestCase()
     QVERIFY(KPackage::PackageLoader::self()->loadPackageStructure("Plasma/TestKPackageInternalPlasmoid"));
 }
 
-static bool checkedInstall(const QString &packageFormat, const QString &source, int expectedError)
+static bool checkedInstall(const QString &packageFormat, const QString &source, int expectedError, const QString &packageRoot = QString())
 {
-    auto job = KPackage::PackageJob::install(packageFormat, source, {});
+    auto job = KPackage::PackageJob::install(packageFormat, source, packageRoot);
     QEventLoop l;
     QObject::connect(job, &KJob::result, &l, [&l]() {
         l.quit();
@@ -69,6 +76,50 @@ void QueryTest::installAndQuery()
     QCOMPARE(KPackage::PackageLoader::self()->listPackages(QStringLiteral("Plasma/TestKPackageInternalPlasmoid")).count(), 3);
 }
 
+// replaces the metadata of the package at @p packagePath the way package managers do, which doesn't touch its root
+static bool replaceDescription(const QString &packagePath, const QByteArray &from, const QByteArray &to)
+{
+    QFile metadata(packagePath + QLatin1String("/metadata.json"));
+    if (!metadata.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const QByteArray contents = metadata.readAll().replace(from, to);
+    metadata.close();
+    QSaveFile replacement(metadata.fileName());
+    return replacement.open(QIODevice::WriteOnly) && replacement.write(contents) == contents.size() && replacement.commit();
+}
+
+void QueryTest::updatedInPlace()
+{
+    const QString packageRoot = m_dataDir.absoluteFilePath(QStringLiteral("plasma/plasmoids"));
+    const QString packagePath = packageRoot + QLatin1String("/org.kde.testpackage");
+    auto description = [this](const QString &root) {
+        const QList<KPluginMetaData> packages = KPackage::PackageLoader::self()->listPackages(packageFormat, root);
+        for (const KPluginMetaData &package : packages) {
+            if (package.pluginId() == QLatin1String("org.kde.testpackage")) {
+                return package.description();
+            }
+        }
+        return QString();
+    };
+    // makes sure the root has an index
+    QCOMPARE(description(packageRoot + QLatin1String("/.")), QStringLiteral("fancy shmancy summary"));
+
+    QTest::qSleep(50);
+    const QDateTime rootModified = QFileInfo(packageRoot).lastModified();
+    QVERIFY(replaceDescription(packagePath, "fancy shmancy summary", "updated summary"));
+    QCOMPARE(QFileInfo(packageRoot).lastModified(), rootModified);
+    // read through the index, which is outdated now
+    QCOMPARE(description(packageRoot + QLatin1String("/./.")), QStringLiteral("updated summary"));
+    // the listings cached by the loader notice it as well, a little later
+    QTRY_COMPARE(description(packageRoot + QLatin1String("/.")), QStringLiteral("updated summary"));
+
+    QTest::qSleep(50);
+    QVERIFY(replaceDescription(packagePath, "updated summary", "fancy shmancy summary"));
+    QCOMPARE(description(packageRoot + QLatin1String("/././.")), QStringLiteral("fancy shmancy summary"));
+    QTRY_COMPARE(description(packageRoot + QLatin1String("/.")), QStringLiteral("fancy shmancy summary"));
+}
+
 void QueryTest::queryCustomPlugin()
 {
     m_dataDir.removeRecursively();
@@ -96,6 +147,202 @@ void QueryTest::queryCustomPlugin()
     QCOMPARE(KPackage::PackageLoader::self()->listPackages(QStringLiteral("Plasma/TestKPackageInternalPlasmoid")).count(), 3);
 }
 
+void QueryTest::listLazily()
+{
+    // the packages installed by queryCustomPlugin are still around
+    const QList<KPackage::Package> packages = KPackage::PackageLoader::self()->listKPackages(packageFormat);
+    const QList<KPackage::Package> lazyPackages = KPackage::PackageLoader::self()->listKPackagesLazily(packageFormat);
+    QCOMPARE(packages.count(), 3);
+    QCOMPARE(lazyPackages.count(), packages.count());
+
+    for (const KPackage::Package &lazyPackage : lazyPackages) {
+        const QString pluginId = lazyPackage.metadata().pluginId();
+        auto it = std::find_if(packages.cbegin(), packages.cend(), [&pluginId](const KPackage::Package &package) {
+            return package.metadata().pluginId() == pluginId;
+        });
+        QVERIFY(it != packages.cend());
+
+        // copies share the setup done on first use
+        const KPackage::Package copy = lazyPackage;
+        QVERIFY(lazyPackage.isValid());
+        QCOMPARE(copy.path(), it->path());
+        QCOMPARE(copy.filePath("mainscript"), it->filePath("mainscript"));
+        QCOMPARE(lazyPackage.entryList("images"), it->entryList("images"));
+    }
+}
+
+void QueryTest::listAsynchronously()
+{
+    // an explicit root isn't in the cache yet, the first job scans it and the second one is served from the cache
+    const QString packageRoot = m_dataDir.absoluteFilePath(QStringLiteral("plasma/plasmoids"));
+    QList<QList<KPluginMetaData>> results;
+    for (int i = 0; i < 2; ++i) {
+        auto job = KPackage::PackageLoader::self()->listPackagesAsync(packageFormat, packageRoot);
+        QList<KPluginMetaData> found;
+        connect(job, &KPackage::PackageListJob::packagesFound, this, [&found](const QList<KPluginMetaData> &batch) {
+            found += batch;
+        });
+        QSignalSpy resultSpy(job, &KJob::result);
+        QVERIFY(resultSpy.wait());
+        QCOMPARE(job->packages(), found);
+        results << found;
+    }
+    QCOMPARE(results.at(0).count(), 3);
+    QCOMPARE(results.at(1), results.at(0));
+    QCOMPARE(KPackage::PackageLoader::self()->listPackages(packageFormat, packageRoot), results.at(0));
+
+    auto job = KPackage::PackageLoader::self()->listPackagesAsync(packageFormat, packageRoot, [](const KPluginMetaData &metadata) {
+        return metadata.pluginId() == QLatin1String("org.kde.testpackage");
+    });
+    QSignalSpy resultSpy(job, &KJob::result);
+    QVERIFY(resultSpy.wait());
+    QCOMPARE(job->packages().count(), 1);
+}
+
+void QueryTest::queryIndexed()
+{
+    auto loader = KPackage::PackageLoader::self();
+    const QList<KPluginMetaData> packages = loader->listPackages(packageFormat);
+    QCOMPARE(packages.count(), 3);
+
+    QCOMPARE(loader->queryPackages(packageFormat, KPackage::PackageQuery()), packages);
+
+    const auto byId = loader->queryPackages(packageFormat, KPackage::PackageQuery().setPluginId(QStringLiteral("org.kde.testpackage")));
+    QCOMPARE(byId.count(), 1);
+    QCOMPARE(byId.first().pluginId(), QStringLiteral("org.kde.testpackage"));
+    QVERIFY(loader->queryPackages(packageFormat, KPackage::PackageQuery().setPluginId(QStringLiteral("org.kde.notinstalled"))).isEmpty());
+
+    const auto byValue = loader->queryPackages(packageFormat, KPackage::PackageQuery().addValue(QStringLiteral("KPackageStructure"), packageFormat));
+    QCOMPARE(byValue, packages);
+    QCOMPARE(loader->queryPackages(packageFormat,
+                                   KPackage::PackageQuery()
+                                       .addValue(QStringLiteral("KPackageStructure"), packageFormat)
+                                       .setPluginId(QStringLiteral("org.kde.testpackage"))),
+             byId);
+
+    const auto byCategory = loader->queryPackages(packageFormat, KPackage::PackageQuery().setCategories({QStringLiteral("Not A Category")}));
+    QVERIFY(byCategory.isEmpty());
+}
+
+void QueryTest::loadById()
+{
+    const QString expectedPath = QDir(m_dataDir.absoluteFilePath(QStringLiteral("plasma/plasmoids/org.kde.testpackage"))).canonicalPath() + QLatin1Char('/');
+
+    auto package = KPackage::PackageLoader::self()->loadPackage(packageFormat, QStringLiteral("org.kde.testpackage"));
+    QVERIFY(package.isValid());
+    QCOMPARE(package.path(), expectedPath);
+    QVERIFY(!package.filePath("mainscript").isEmpty());
+
+    // answered from the lookup cache the second time
+    package = KPackage::PackageLoader::self()->loadPackage(packageFormat, QStringLiteral("org.kde.testpackage"));
+    QCOMPARE(package.path(), expectedPath);
+
+    package = KPackage::PackageLoader::self()->loadPackage(packageFormat, QStringLiteral("org.kde.notinstalled"));
+    QVERIFY(!package.isValid());
+}
+
+void QueryTest::concurrentLookups()
+{
+    const QString expectedPath = QDir(m_dataDir.absoluteFilePath(QStringLiteral("plasma/plasmoids/org.kde.testpackage"))).canonicalPath() + QLatin1Char('/');
+    const QString packageRoot = m_dataDir.absoluteFilePath(QStringLiteral("plasma/plasmoids"));
+    std::atomic_int failures = 0;
+
+    // readers on several threads while new listings keep getting published
+    QList<QThread *> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads << QThread::create([&]() {
+            auto loader = KPackage::PackageLoader::self();
+            for (int j = 0; j < 50; ++j) {
+                if (loader->listPackages(packageFormat).count() != 3 || loader->listPackages(packageFormat, packageRoot).count() != 3) {
+                    ++failures;
+                }
+                if (loader->queryPackages(packageFormat, KPackage::PackageQuery().addValue(QStringLiteral("KPackageStructure"), packageFormat)).count() != 3) {
+                    ++failures;
+                }
+                if (loader->loadPackage(packageFormat, QStringLiteral("org.kde.testpackage")).path() != expectedPath) {
+                    ++failures;
+                }
+            }
+        });
+        threads.constLast()->start();
+    }
+    for (int j = 0; j < 50; ++j) {
+        if (KPackage::PackageLoader::self()->listPackages(packageFormat, packageRoot + QLatin1Char('/') + QString::number(j)).count() != 0) {
+            ++failures;
+        }
+    }
+    // joined before anything gets checked, a failing check returns early and the threads use the locals of this function
+    bool joined = true;
+    for (QThread *thread : std::as_const(threads)) {
+        joined = thread->wait() && joined;
+        delete thread;
+    }
+    QVERIFY(joined);
+    QCOMPARE(failures, 0);
+}
+
+void QueryTest::sharedIndex()
+{
+    // stands in for a system-wide data directory like /usr/share
+    QTemporaryDir systemDataDir;
+    QVERIFY(systemDataDir.isValid());
+    qputenv("XDG_DATA_DIRS", QFile::encodeName(systemDataDir.path()));
+    const QString packageRoot = systemDataDir.filePath(QStringLiteral("plasma/plasmoids"));
+    QVERIFY(checkedInstall(packageFormat, QFINDTESTDATA("data/testpackage"), KJob::NoError, packageRoot));
+
+    const QString userIndexes = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QLatin1String("/kpackage/index");
+    QVERIFY(KPackage::PackageLoader::generateSharedIndex(packageRoot));
+    QCOMPARE(QDir(systemDataDir.filePath(QStringLiteral("kpackage/index"))).entryList(QDir::Files).count(), 1);
+
+    // without an index in the user's cache the shared one gets used, as is
+    QVERIFY(QDir(userIndexes).removeRecursively());
+    QCOMPARE(KPackage::PackageLoader::self()->listPackages(packageFormat, packageRoot).count(), 1);
+    QVERIFY(!QFileInfo::exists(userIndexes));
+
+    QVERIFY(KPackage::PackageLoader::removeSharedIndex(packageRoot));
+    QVERIFY(!KPackage::PackageLoader::removeSharedIndex(packageRoot));
+    // the data directory of the user is no place for an index shared with others
+    QVERIFY(!KPackage::PackageLoader::generateSharedIndex(m_dataDir.absoluteFilePath(QStringLiteral("plasma/plasmoids"))));
+    // and neither are the roots outside of the data directories
+    QVERIFY(!KPackage::PackageLoader::generateSharedIndex(QDir::tempPath()));
+    qputenv("XDG_DATA_DIRS", "/not/valid");
+}
+
+void QueryTest::listByFormat()
+{
+    const QString packageRoot = m_dataDir.absoluteFilePath(QStringLiteral("plasma/plasmoids"));
+    const QString otherFormat = QStringLiteral("KPackage/Generic");
+    const auto packages = KPackage::PackageLoader::self()->listPackagesByFormat({packageFormat, otherFormat}, packageRoot);
+    QCOMPARE(packages.count(), 2);
+    QCOMPARE(packages.value(packageFormat).count(), 3);
+    QVERIFY(packages.value(otherFormat).isEmpty());
+
+    // the listings are cached like the ones of listPackages
+    QCOMPARE(packages.value(packageFormat), KPackage::PackageLoader::self()->listPackages(packageFormat, packageRoot));
+    QCOMPARE(KPackage::PackageLoader::self()->listPackagesByFormat({packageFormat}, packageRoot).value(packageFormat), packages.value(packageFormat));
+}
+
+void QueryTest::installedManifest()
+{
+    const QString packagePath = m_dataDir.absoluteFilePath(QStringLiteral("plasma/plasmoids/org.kde.testpackage"));
+    auto package = KPackage::PackageLoader::self()->loadPackage(packageFormat, packagePath);
+    QVERIFY(package.isValid());
+    const QString uiPath = QDir(packagePath).canonicalPath() + QLatin1String("/contents/ui/");
+    QCOMPARE(package.filePath("mainscript"), uiPath + QLatin1String("main.qml"));
+    QCOMPARE(package.filePath("ui", QStringLiteral("otherfile.qml")), uiPath + QLatin1String("otherfile.qml"));
+    QCOMPARE(package.filePath("ui", QStringLiteral("doesnotexist.qml")), QString());
+    QCOMPARE(package.entryList("images"), QStringList{QStringLiteral("empty.png")});
+
+    // files added after the installation are still found, the manifest is outdated then
+    QTest::qSleep(50);
+    QFile newFile(uiPath + QLatin1String("newfile.qml"));
+    QVERIFY(newFile.open(QIODevice::WriteOnly));
+    newFile.close();
+    package = KPackage::PackageLoader::self()->loadPackage(packageFormat, packagePath);
+    QCOMPARE(package.filePath("ui", QStringLiteral("newfile.qml")), uiPath + QLatin1String("newfile.qml"));
+    QVERIFY(newFile.remove());
+}
+
 QTEST_MAIN(QueryTest)
 
 #include "moc_querytest.cpp"
@@ -19,7 +19,16 @@ class QueryTest : public QObject
 private Q_SLOTS:
     void initTestCase();
     void installAndQuery();
+    void updatedInPlace();
     void queryCustomPlugin();
+    void listLazily();
+    void listAsynchronously();
+    void queryIndexed();
+    void loadById();
+    void concurrentLookups();
+    void sharedIndex();
+    void listByFormat();
+    void installedManifest();
 
 private:
     const QString packageFormat = "Plasma/TestKPackageInternalPlasmoid";
@@ -1,4 +1,8 @@
+#cmakedefine01 HAVE_COPY_FILE_RANGE
+#cmakedefine01 HAVE_RENAMEAT2
 
 #define KPACKAGE_RELATIVE_DATA_INSTALL_DIR "@KPACKAGE_RELATIVE_DATA_INSTALL_DIR@"
 
 #define KDE_INSTALL_FULL_LIBEXECDIR_KF "@KDE_INSTALL_FULL_LIBEXECDIR_KF@"
+
+#cmakedefine01 HAVE_POSIX_FADVISE
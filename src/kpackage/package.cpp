@@ -9,24 +9,32 @@
 
 #include "package.h"
 
+#include <QMimeDatabase>
 #include <QResource>
-#include <qtemporarydir.h>
+#include <QSet>
+
+#include <algorithm>
 
 #include "kpackage_debug.h"
-#include <KArchive>
 #include <KLocalizedString>
-#include <KTar>
-#include <kzip.h>
 
 #include "config-package.h"
 
-#include <QMimeDatabase>
 #include <QStandardPaths>
 
+#if HAVE_POSIX_FADVISE
+#include <fcntl.h>
+#endif
+
 #include "packageloader.h"
+#include "packageprefetchjob.h"
 #include "packagestructure.h"
+#include "private/instrumentation_p.h"
 #include "private/package_p.h"
+#include "private/packagearchive_p.h"
+#include "private/packagehasher_p.h"
 #include "private/packageloader_p.h"
+#include "private/packagestructure_p.h"
 
 namespace KPackage
 {
@@ -36,8 +44,13 @@ Package::Package(PackageStructure *structure)
     d->structure = structure;
 
     if (d->structure) {
-        addFileDefinition("metadata", QStringLiteral("metadata.json"));
-        d->structure.data()->initPackage(this);
+        if (const auto packageTemplate = PackageStructurePrivate::get(structure)->packageTemplate(structure)) {
+            // only takes references on the definitions of the template, initPackage doesn't run again
+            *d = *packageTemplate;
+        } else {
+            addFileDefinition("metadata", QStringLiteral("metadata.json"));
+            d->structure.data()->initPackage(this);
+        }
     }
 }
 
@@ -65,6 +78,7 @@ bool Package::hasValidStructure() const
 
 bool Package::isValid() const
 {
+    d->ensureInitialized();
     if (!d->structure) {
         return false;
     }
@@ -103,6 +117,7 @@ bool Package::isValid() const
 
 bool Package::isRequired(const QByteArray &key) const
 {
+    d->ensureInitialized();
     auto it = d->contents.constFind(key);
     if (it == d->contents.constEnd()) {
         return false;
@@ -113,6 +128,7 @@ bool Package::isRequired(const QByteArray &key) const
 
 QStringList Package::mimeTypes(const QByteArray &key) const
 {
+    d->ensureInitialized();
     auto it = d->contents.constFind(key);
     if (it == d->contents.constEnd()) {
         return QStringList();
@@ -127,11 +143,13 @@ QStringList Package::mimeTypes(const QByteArray &key) const
 
 QString Package::defaultPackageRoot() const
 {
+    d->ensureInitialized();
     return d->defaultPackageRoot;
 }
 
 void Package::setDefaultPackageRoot(const QString &packageRoot)
 {
+    d->ensureInitialized();
     d.detach();
     d->defaultPackageRoot = packageRoot;
     if (!d->defaultPackageRoot.isEmpty() && !d->defaultPackageRoot.endsWith(QLatin1Char('/'))) {
@@ -141,17 +159,22 @@ void Package::setDefaultPackageRoot(const QString &packageRoot)
 
 void Package::setFallbackPackage(const KPackage::Package &package)
 {
+    d->ensureInitialized();
+    package.d->ensureInitialized();
     if ((d->fallbackPackage && d->fallbackPackage->path() == package.path() && d->fallbackPackage->metadata() == package.metadata()) ||
         // can't be fallback of itself
-        (package.path() == path() && package.metadata() == metadata()) || d->hasCycle(package)) {
+        package.d->fallbackId() == d->fallbackId() || d->hasCycle(package)) {
         return;
     }
 
     d->fallbackPackage = std::make_unique<Package>(package);
+    d->rootPathFallback.clear();
+    d->clearDiscoveries();
 }
 
 KPackage::Package Package::fallbackPackage() const
 {
+    d->ensureInitialized();
     if (d->fallbackPackage) {
         return (*d->fallbackPackage);
     } else {
@@ -161,19 +184,23 @@ KPackage::Package Package::fallbackPackage() const
 
 bool Package::allowExternalPaths() const
 {
+    d->ensureInitialized();
     return d->externalPaths;
 }
 
 void Package::setMetadata(const KPluginMetaData &data)
 {
+    d->ensureInitialized();
     Q_ASSERT(data.isValid());
     d->metadata = data;
 }
 
 void Package::setAllowExternalPaths(bool allow)
 {
+    d->ensureInitialized();
     d.detach();
     d->externalPaths = allow;
+    d->clearDiscoveries();
 }
 
 KPluginMetaData Package::metadata() const
@@ -213,48 +240,15 @@ KPluginMetaData Package::metadata() const
 
 QString PackagePrivate::unpack(const QString &filePath)
 {
-    KArchive *archive = nullptr;
-    QMimeDatabase db;
-    QMimeType mimeType = db.mimeTypeForFile(filePath);
-
-    if (mimeType.inherits(QStringLiteral("application/zip"))) {
-        archive = new KZip(filePath);
-    } else if (mimeType.inherits(QStringLiteral("application/x-compressed-tar")) || //
-               mimeType.inherits(QStringLiteral("application/x-gzip")) || //
-               mimeType.inherits(QStringLiteral("application/x-tar")) || //
-               mimeType.inherits(QStringLiteral("application/x-bzip-compressed-tar")) || //
-               mimeType.inherits(QStringLiteral("application/x-xz")) || //
-               mimeType.inherits(QStringLiteral("application/x-lzma"))) {
-        archive = new KTar(filePath);
-    } else {
-        // qCWarning(KPACKAGE_LOG) << "Could not open package file, unsupported archive format:" << filePath << mimeType.name();
-    }
-    QString tempRoot;
-    if (archive && archive->open(QIODevice::ReadOnly)) {
-        const KArchiveDirectory *source = archive->directory();
-        QTemporaryDir tempdir;
-        tempdir.setAutoRemove(false);
-        tempRoot = tempdir.path() + QLatin1Char('/');
-        source->copyTo(tempRoot);
-
-        if (!QFile::exists(tempdir.path() + QLatin1String("/metadata.json"))) {
-            // search metadata.json, the zip file might have the package contents in a subdirectory
-            QDir unpackedPath(tempdir.path());
-            const auto entries = unpackedPath.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
-            for (const auto &pack : entries) {
-                if (QFile::exists(pack.filePath() + QLatin1String("/metadata.json"))) {
-                    tempRoot = pack.filePath() + QLatin1Char('/');
-                }
-            }
-        }
-
-        createPackageMetadata(tempRoot);
-    } else {
-        // qCWarning(KPACKAGE_LOG) << "Could not open package file:" << path;
+    archive = PackageArchive::open(filePath);
+    if (!archive) {
+        return QString();
     }
-
-    delete archive;
-    return tempRoot;
+    // the archive is only extracted piecewise by findFilePath, see PackageArchive
+    if (const KPluginMetaData archiveMetadata = archive->metadata(); archiveMetadata.isValid()) {
+        metadata = archiveMetadata;
+    }
+    return archive->root();
 }
 
 bool PackagePrivate::isInsidePackageDir(const QString &canonicalPath) const
@@ -291,6 +285,7 @@ bool PackagePrivate::isInsidePackageDir(const QString &canonicalPath) const
 
 QString Package::filePath(const QByteArray &fileType, const QString &filename) const
 {
+    d->ensureInitialized();
     if (!d->valid && d->checkedValid) { // Don't check the validity here, because we'd have infinite recursion
         QString result = d->fallbackFilePath(fileType, filename);
         if (result.isEmpty()) {
@@ -300,77 +295,106 @@ QString Package::filePath(const QByteArray &fileType, const QString &filename) c
         return result;
     }
 
-    const QString discoveryKey(QString::fromUtf8(fileType) + filename);
-    const auto path = d->discoveries.value(discoveryKey);
-    if (!path.isEmpty()) {
-        return path;
+    // misses are remembered as well, including what the fallback package answered for them:
+    // optional files get asked for over and over. The cache is dropped whenever the path,
+    // the prefixes, the definitions or the fallback package change.
+    const QString discoveryKey(QString::fromUtf8(fileType) + QLatin1Char('\0') + filename);
+    if (const auto it = d->discoveries.constFind(discoveryKey); it != d->discoveries.constEnd()) {
+        Instrumentation::count(Instrumentation::DiscoveryCacheHits);
+        return it.value();
     }
+    Instrumentation::count(Instrumentation::DiscoveryCacheMisses);
 
+    const QString file = d->findFilePath(fileType, filename);
+    const QString result = file.isEmpty() ? d->fallbackFilePath(fileType, filename) : file;
+    if (result.isEmpty()) {
+        Instrumentation::count(Instrumentation::FilePathMisses);
+    }
+    d->discoveries.insert(discoveryKey, result);
+    return result;
+}
+
+QString PackagePrivate::findFilePath(const QByteArray &fileType, const QString &filename) const
+{
     QStringList paths;
 
     if (!fileType.isEmpty()) {
-        const auto contents = d->contents.constFind(fileType);
-        if (contents == d->contents.constEnd()) {
+        const auto it = contents.constFind(fileType);
+        if (it == contents.constEnd()) {
             // qCDebug(KPACKAGE_LOG) << "package does not contain" << fileType << filename;
-            return d->fallbackFilePath(fileType, filename);
+            return QString();
         }
 
-        paths = contents->paths;
+        paths = it->paths;
 
         if (paths.isEmpty()) {
             // qCDebug(KPACKAGE_LOG) << "no matching path came of it, while looking for" << fileType << filename;
-            d->discoveries.insert(discoveryKey, QString());
-            return d->fallbackFilePath(fileType, filename);
+            return QString();
         }
     } else {
         // when filetype is empty paths is always empty, so try with an empty string
         paths << QString();
     }
 
+    const Instrumentation::Span span(Instrumentation::FileLookup, path);
+    const PackageManifest *packageManifest = tempRoot.isEmpty() ? manifest() : nullptr;
+
     // Nested loop, but in the medium case resolves to just one iteration
-    //     qCDebug(KPACKAGE_LOG) << "prefixes:" << d->contentsPrefixPaths.count() << d->contentsPrefixPaths;
-    for (const QString &contentsPrefix : std::as_const(d->contentsPrefixPaths)) {
+    //     qCDebug(KPACKAGE_LOG) << "prefixes:" << contentsPrefixPaths.count() << contentsPrefixPaths;
+    for (const QString &contentsPrefix : std::as_const(contentsPrefixPaths)) {
         QString prefix;
         // We are an installed package
-        if (d->tempRoot.isEmpty()) {
-            prefix = fileType == "metadata" ? d->path : (d->path + contentsPrefix);
+        if (tempRoot.isEmpty()) {
+            prefix = fileType == "metadata" ? path : (path + contentsPrefix);
             // We are a compressed package temporarily uncompressed in /tmp
         } else {
-            prefix = fileType == "metadata" ? d->tempRoot : (d->tempRoot + contentsPrefix);
+            prefix = fileType == "metadata" ? tempRoot : (tempRoot + contentsPrefix);
         }
 
-        for (const QString &path : std::as_const(paths)) {
-            QString file = prefix + path;
+        for (const QString &entryPath : std::as_const(paths)) {
+            QString file = prefix + entryPath;
 
             if (!filename.isEmpty()) {
                 file.append(QLatin1Char('/') + filename);
             }
 
+            if (const auto relativePath = packageManifest ? manifestPath(file) : std::nullopt) {
+                const int flags = packageManifest->flags(*relativePath);
+                if (flags >= 0 && (externalPaths || (flags & PackageManifest::InsidePackage))) {
+                    return file;
+                }
+                continue;
+            }
+
+            if (archive) {
+                archive->extract(file.mid(tempRoot.size()));
+            }
+
+            Instrumentation::count(Instrumentation::FileProbes);
             QFileInfo fi(file);
             if (fi.exists()) {
-                if (d->externalPaths) {
+                if (externalPaths) {
                     // qCDebug(KPACKAGE_LOG) << "found" << file;
-                    d->discoveries.insert(discoveryKey, file);
                     return file;
                 }
 
                 // ensure that we don't return files outside of our base path
                 // due to symlink or ../ games
-                if (d->isInsidePackageDir(fi.canonicalFilePath())) {
+                if (isInsidePackageDir(fi.canonicalFilePath())) {
                     // qCDebug(KPACKAGE_LOG) << "found" << file;
-                    d->discoveries.insert(discoveryKey, file);
                     return file;
                 }
             }
         }
     }
 
-    // qCDebug(KPACKAGE_LOG) << fileType << filename << "does not exist in" << prefixes << "at root" << d->path;
-    return d->fallbackFilePath(fileType, filename);
+    // qCDebug(KPACKAGE_LOG) << fileType << filename << "does not exist in" << prefixes << "at root" << path;
+    return QString();
 }
 
 QUrl Package::fileUrl(const QByteArray &fileType, const QString &filename) const
 {
+    d->ensureInitialized();
     QString path = filePath(fileType, filename);
     // construct a qrc:/ url or a file:/ url, the only two protocols supported
     if (path.startsWith(QStringLiteral(":"))) {
@@ -382,6 +406,35 @@ QUrl Package::fileUrl(const QByteArray &fileType, const QString &filename) const
 
 QStringList Package::entryList(const QByteArray &key) const
 {
+    d->ensureInitialized();
+    if (!d->valid) {
+        return QStringList();
+    }
+
+    const auto it = d->contents.constFind(key);
+    if (it == d->contents.constEnd()) {
+        qCWarning(KPACKAGE_LOG) << "couldn't find" << key << "when trying to list entries";
+        return QStringList();
+    }
+    // not cached, callers rely on seeing the files added since the previous call
+    return d->listEntries(it.value());
+}
+
+static bool matchesMimeTypes(const QMimeDatabase &db, const QString &fileName, const QStringList &mimeTypes)
+{
+    // the name tells, the files don't get opened
+    const QMimeType mimeType = db.mimeTypeForFile(fileName, QMimeDatabase::MatchExtension);
+    return std::any_of(mimeTypes.cbegin(), mimeTypes.cend(), [&mimeType](const QString &name) {
+        if (name.endsWith(QLatin1String("/*"))) {
+            return mimeType.name().startsWith(QStringView(name).chopped(1));
+        }
+        return mimeType.inherits(name);
+    });
+}
+
+QStringList Package::entryList(const QByteArray &key, EntryListOptions options, qsizetype offset, qsizetype count) const
+{
+    d->ensureInitialized();
     if (!d->valid) {
         return QStringList();
     }
@@ -392,40 +445,90 @@ QStringList Package::entryList(const QByteArray &key) const
         return QStringList();
     }
 
+    // the directories are listed once, until the path or the definitions change
+    const QString cacheKey = QString::fromUtf8(key) + QLatin1Char('\0') + QString::number(options.toInt());
+    auto cached = d->entries.constFind(cacheKey);
+    if (cached == d->entries.constEnd()) {
+        QStringList list;
+        if (options == NoEntryListOptions) {
+            list = d->listEntries(it.value());
+        } else {
+            list = entryList(key, NoEntryListOptions);
+            const QStringList types = mimeTypes(key);
+            if (options.testFlag(FilterByMimeType) && !types.isEmpty()) {
+                const QMimeDatabase db;
+                list.removeIf([&db, &types](const QString &entry) {
+                    return !matchesMimeTypes(db, entry, types);
+                });
+            }
+            if (options.testFlag(SortByName)) {
+                std::sort(list.begin(), list.end(), [](const QString &left, const QString &right) {
+                    return QString::compare(left, right, Qt::CaseInsensitive) < 0;
+                });
+            }
+        }
+        cached = d->entries.insert(cacheKey, list);
+    }
+
+    if (offset <= 0 && count < 0) {
+        return cached.value();
+    }
+    return cached.value().mid(std::max<qsizetype>(offset, 0), count);
+}
+
+QStringList PackagePrivate::listEntries(const ContentStructure &content) const
+{
+    const PackageManifest *packageManifest = tempRoot.isEmpty() ? manifest() : nullptr;
+
     QStringList list;
-    for (const QString &prefix : std::as_const(d->contentsPrefixPaths)) {
+    for (const QString &prefix : std::as_const(contentsPrefixPaths)) {
         // qCDebug(KPACKAGE_LOG) << "     looking in" << prefix;
-        const QStringList paths = it.value().paths;
+        const QStringList paths = content.paths;
         for (const QString &path : paths) {
             // qCDebug(KPACKAGE_LOG) << "         looking in" << path;
-            if (it.value().directory) {
-                // qCDebug(KPACKAGE_LOG) << "it's a directory, so trying out" << d->path + prefix + path;
-                QDir dir(d->path + prefix + path);
-                if (d->externalPaths) {
+            if (const auto relativePath = packageManifest ? manifestPath(this->path + prefix + path) : std::nullopt) {
+                const int flags = packageManifest->flags(*relativePath);
+                if (flags < 0 || !(externalPaths || (flags & PackageManifest::InsidePackage))) {
+                    continue;
+                }
+                if (content.directory) {
+                    if (flags & PackageManifest::Directory) {
+                        list += packageManifest->readableFiles(*relativePath);
+                    }
+                } else {
+                    list += this->path + prefix + path;
+                }
+                continue;
+            }
+
+            if (content.directory) {
+                // qCDebug(KPACKAGE_LOG) << "it's a directory, so trying out" << this->path + prefix + path;
+                QDir dir(this->path + prefix + path);
+                if (externalPaths) {
                     list += dir.entryList(QDir::Files | QDir::Readable);
                 } else {
                     // ensure that we don't return files outside of our base path
                     // due to symlink or ../ games
                     QString canonicalized = dir.canonicalPath();
-                    if (canonicalized.startsWith(d->path)) {
+                    if (canonicalized.startsWith(this->path)) {
                         list += dir.entryList(QDir::Files | QDir::Readable);
                     }
                 }
             } else {
-                const QString fullPath = d->path + prefix + path;
+                const QString fullPath = this->path + prefix + path;
                 // qCDebug(KPACKAGE_LOG) << "it's a file at" << fullPath << QFile::exists(fullPath);
                 if (!QFile::exists(fullPath)) {
                     continue;
                 }
 
-                if (d->externalPaths) {
+                if (externalPaths) {
                     list += fullPath;
                 } else {
                     QDir dir(fullPath);
                     QString canonicalized = dir.canonicalPath() + QDir::separator();
 
-                    // qCDebug(KPACKAGE_LOG) << "testing that" << canonicalized << "is in" << d->path;
-                    if (canonicalized.startsWith(d->path)) {
+                    // qCDebug(KPACKAGE_LOG) << "testing that" << canonicalized << "is in" << this->path;
+                    if (canonicalized.startsWith(this->path)) {
                         list += fullPath;
                     }
                 }
@@ -438,11 +541,14 @@ QStringList Package::entryList(const QByteArray &key) const
 
 void Package::setPath(const QString &path)
 {
+    d->ensureInitialized();
     // if the path is already what we have, don't bother
     if (path == d->path) {
         return;
     }
 
+    const Instrumentation::Span span(Instrumentation::SetPath, path);
+
     // our dptr is shared, and it is almost certainly going to change.
     // hold onto the old pointer just in case it does not, however!
     QExplicitlySharedDataPointer<PackagePrivate> oldD(d);
@@ -452,7 +558,7 @@ void Package::setPath(const QString &path)
     // without structure we're doomed
     if (!d->structure) {
         d->path.clear();
-        d->discoveries.clear();
+        d->clearDiscoveries();
         d->valid = false;
         d->checkedValid = true;
         qCWarning(KPACKAGE_LOG) << "Cannot set a path in a package without structure" << path;
@@ -462,7 +568,7 @@ void Package::setPath(const QString &path)
     // empty path => nothing to do
     if (path.isEmpty()) {
         d->path.clear();
-        d->discoveries.clear();
+        d->clearDiscoveries();
         d->valid = false;
         d->structure.data()->pathChanged(this);
         return;
@@ -514,15 +620,21 @@ void Package::setPath(const QString &path)
         Q_ASSERT(QFile::exists(dir.canonicalPath()));
 
         d->path = dir.canonicalPath();
+        // what was found or missed in the previous candidate says nothing about this one
+        d->clearDiscoveries();
         // canonicalPath() does not include a trailing slash (unless it is the root dir)
         if (!d->path.endsWith(QLatin1Char('/'))) {
             d->path.append(QLatin1Char('/'));
         }
 
         const QString fallbackPath = metadata().value(QStringLiteral("X-Plasma-RootPath"));
-        if (!fallbackPath.isEmpty()) {
+        // loaded once, setPath gets called again and again for the same root
+        if (!fallbackPath.isEmpty() && (!d->fallbackPackage || d->rootPathFallback != fallbackPath)) {
             const KPackage::Package fp = KPackage::PackageLoader::self()->loadPackage(QStringLiteral("Plasma/Applet"), fallbackPath);
             setFallbackPackage(fp);
+            if (d->fallbackPackage && d->fallbackPackage->d == fp.d) {
+                d->rootPathFallback = fallbackPath;
+            }
         }
 
         // we need to tell the structure we're changing paths ...
@@ -540,7 +652,7 @@ void Package::setPath(const QString &path)
     }
 
     // .. but something did change, so we get rid of our discovery cache
-    d->discoveries.clear();
+    d->clearDiscoveries();
 
     // Do NOT override the metadata when the PackageStructure has set it
     if (!previousPath.isEmpty()) {
@@ -557,18 +669,22 @@ void Package::setPath(const QString &path)
 
 const QString Package::path() const
 {
+    d->ensureInitialized();
     return d->path;
 }
 
 QStringList Package::contentsPrefixPaths() const
 {
+    d->ensureInitialized();
     return d->contentsPrefixPaths;
 }
 
 void Package::setContentsPrefixPaths(const QStringList &prefixPaths)
 {
+    d->ensureInitialized();
     d.detach();
     d->contentsPrefixPaths = prefixPaths;
+    d->clearDiscoveries();
     if (d->contentsPrefixPaths.isEmpty()) {
         d->contentsPrefixPaths << QString();
     } else {
@@ -587,43 +703,18 @@ void Package::setContentsPrefixPaths(const QStringList &prefixPaths)
 
 QByteArray Package::cryptographicHash(QCryptographicHash::Algorithm algorithm) const
 {
+    d->ensureInitialized();
     if (!d->valid) {
         qCWarning(KPACKAGE_LOG) << "can not create hash due to Package being invalid";
         return QByteArray();
     }
 
-    QCryptographicHash hash(algorithm);
-    const QString guessedMetaDataJson = d->path + QLatin1String("metadata.json");
-    const QString metadataPath = QFile::exists(guessedMetaDataJson) ? guessedMetaDataJson : QString();
-    if (!metadataPath.isEmpty()) {
-        QFile f(metadataPath);
-        if (f.open(QIODevice::ReadOnly)) {
-            while (!f.atEnd()) {
-                hash.addData(f.read(1024));
-            }
-        } else {
-            qCWarning(KPACKAGE_LOG) << "could not add" << f.fileName() << "to the hash; file could not be opened for reading.";
-        }
-    } else {
-        qCWarning(KPACKAGE_LOG) << "no metadata at" << metadataPath;
-    }
-
-    for (const QString &prefix : std::as_const(d->contentsPrefixPaths)) {
-        const QString basePath = d->path + prefix;
-        QDir dir(basePath);
-
-        if (!dir.exists()) {
-            return QByteArray();
-        }
-
-        d->updateHash(basePath, QString(), dir, hash);
-    }
-
-    return hash.result().toHex();
+    return PackageHasher::hash(d->path, d->contentsPrefixPaths, algorithm);
 }
 
 void Package::addDirectoryDefinition(const QByteArray &key, const QString &path)
 {
+    d->ensureInitialized();
     const auto contentsIt = d->contents.constFind(key);
     ContentStructure s;
 
@@ -640,10 +731,12 @@ void Package::addDirectoryDefinition(const QByteArray &key, const QString &path)
     s.directory = true;
 
     d->contents[key] = s;
+    d->clearDiscoveries();
 }
 
 void Package::addFileDefinition(const QByteArray &key, const QString &path)
 {
+    d->ensureInitialized();
     const auto contentsIt = d->contents.constFind(key);
     ContentStructure s;
 
@@ -660,23 +753,26 @@ void Package::addFileDefinition(const QByteArray &key, const QString &path)
     s.directory = false;
 
     d->contents[key] = s;
+    d->clearDiscoveries();
 }
 
 void Package::removeDefinition(const QByteArray &key)
 {
+    d->ensureInitialized();
     if (d->contents.contains(key)) {
         d.detach();
         d->contents.remove(key);
     }
 
-    if (d->discoveries.contains(QString::fromLatin1(key))) {
+    if (!d->discoveries.isEmpty() || !d->entries.isEmpty()) {
         d.detach();
-        d->discoveries.remove(QString::fromLatin1(key));
+        d->clearDiscoveries();
     }
 }
 
 void Package::setRequired(const QByteArray &key, bool required)
 {
+    d->ensureInitialized();
     QHash<QByteArray, ContentStructure>::iterator it = d->contents.find(key);
     if (it == d->contents.end()) {
         qCWarning(KPACKAGE_LOG) << key << "is now a known key for the package. File is thus not set to being required";
@@ -691,22 +787,27 @@ void Package::setRequired(const QByteArray &key, bool required)
 
 void Package::setDefaultMimeTypes(const QStringList &mimeTypes)
 {
+    d->ensureInitialized();
     d.detach();
     d->mimeTypes = mimeTypes;
+    d->entries.clear();
 }
 
 void Package::setMimeTypes(const QByteArray &key, const QStringList &mimeTypes)
 {
+    d->ensureInitialized();
     if (!d->contents.contains(key)) {
         return;
     }
 
     d.detach();
     d->contents[key].mimeTypes = mimeTypes;
+    d->entries.clear();
 }
 
 QList<QByteArray> Package::directories() const
 {
+    d->ensureInitialized();
     QList<QByteArray> dirs;
     for (auto it = d->contents.cbegin(); it != d->contents.cend(); ++it) {
         if (it.value().directory) {
@@ -718,6 +819,7 @@ QList<QByteArray> Package::directories() const
 
 QList<QByteArray> Package::requiredDirectories() const
 {
+    d->ensureInitialized();
     QList<QByteArray> dirs;
     for (auto it = d->contents.cbegin(); it != d->contents.cend(); ++it) {
         if (it.value().directory && it.value().required) {
@@ -729,6 +831,7 @@ QList<QByteArray> Package::requiredDirectories() const
 
 QList<QByteArray> Package::files() const
 {
+    d->ensureInitialized();
     QList<QByteArray> files;
     for (auto it = d->contents.cbegin(); it != d->contents.cend(); ++it) {
         if (!it.value().directory) {
@@ -738,8 +841,16 @@ QList<QByteArray> Package::files() const
     return files;
 }
 
+PackagePrefetchJob *Package::prefetch(const QList<QByteArray> &fileTypes) const
+{
+    auto job = new PackagePrefetchJob({*this}, fileTypes);
+    job->start();
+    return job;
+}
+
 QList<QByteArray> Package::requiredFiles() const
 {
+    d->ensureInitialized();
     QList<QByteArray> files;
     for (auto it = d->contents.cbegin(); it != d->contents.cend(); ++it) {
         if (!it.value().directory && it.value().required) {
@@ -765,13 +876,7 @@ PackagePrivate::PackagePrivate(const PackagePrivate &other)
     }
 }
 
-PackagePrivate::~PackagePrivate()
-{
-    if (!tempRoot.isEmpty()) {
-        QDir dir(tempRoot);
-        dir.removeRecursively();
-    }
-}
+PackagePrivate::~PackagePrivate() = default;
 
 PackagePrivate &PackagePrivate::operator=(const PackagePrivate &rhs)
 {
@@ -785,10 +890,16 @@ PackagePrivate &PackagePrivate::operator=(const PackagePrivate &rhs)
     } else {
         fallbackPackage = nullptr;
     }
+    rootPathFallback = rhs.rootPathFallback;
     if (rhs.metadata && rhs.metadata.value().isValid()) {
         metadata = rhs.metadata;
     }
     path = rhs.path;
+    // the extracted files go away with the last package sharing the archive
+    archive = rhs.archive;
+    tempRoot = rhs.tempRoot;
+    loadedManifest = rhs.loadedManifest;
+    loadedManifestPath = rhs.loadedManifestPath;
     contentsPrefixPaths = rhs.contentsPrefixPaths;
     contents = rhs.contents;
     mimeTypes = rhs.mimeTypes;
@@ -798,62 +909,49 @@ PackagePrivate &PackagePrivate::operator=(const PackagePrivate &rhs)
     return *this;
 }
 
-void PackagePrivate::updateHash(const QString &basePath, const QString &subPath, const QDir &dir, QCryptographicHash &hash)
+QExplicitlySharedDataPointer<PackagePrivate> PackagePrivate::initializedBy(PackageStructure *structure)
 {
-    // hash is calculated as a function of:
-    // * files ordered alphabetically by name, with each file's:
-    //      * path relative to the content root
-    //      * file data
-    // * directories ordered alphabetically by name, with each dir's:
-    //      * path relative to the content root
-    //      * file listing (recursing)
-    // symlinks (in both the file and dir case) are handled by adding
-    // the name of the symlink itself and the abs path of what it points to
-
-    const QDir::SortFlags sorting = QDir::Name | QDir::IgnoreCase;
-    const QDir::Filters filters = QDir::Hidden | QDir::System | QDir::NoDotAndDotDot;
-    const auto lstEntries = dir.entryList(QDir::Files | filters, sorting);
-    for (const QString &file : lstEntries) {
-        if (!subPath.isEmpty()) {
-            hash.addData(subPath.toUtf8());
-        }
-
-        hash.addData(file.toUtf8());
-
-        QFileInfo info(dir.path() + QLatin1Char('/') + file);
-        if (info.isSymLink()) {
-            hash.addData(info.symLinkTarget().toUtf8());
-        } else {
-            QFile f(info.filePath());
-            if (f.open(QIODevice::ReadOnly)) {
-                while (!f.atEnd()) {
-                    hash.addData(f.read(1024));
-                }
-            } else {
-                qCWarning(KPACKAGE_LOG) << "could not add" << f.fileName() << "to the hash; file could not be opened for reading. "
-                                        << "permissions fail?" << info.permissions() << info.isFile();
-            }
-        }
-    }
-
-    const auto lstEntries2 = dir.entryList(QDir::Dirs | filters, sorting);
-    for (const QString &subDirPath : lstEntries2) {
-        const QString relativePath = subPath + subDirPath + QLatin1Char('/');
-        hash.addData(relativePath.toUtf8());
+    Package package;
+    package.d->structure = structure;
+    package.addFileDefinition("metadata", QStringLiteral("metadata.json"));
+    structure->initPackage(&package);
+    return package.d;
+}
 
-        QDir subDir(dir.path());
-        subDir.cd(subDirPath);
+Package PackagePrivate::createLazyPackage(PackageStructure *structure, const QString &path, const KPluginMetaData &metadata)
+{
+    // no structure yet, initPackage must not run now
+    Package package;
+    package.d->structure = structure;
+    package.d->lazyPath = path;
+    package.d->metadata = metadata;
+    package.d->lazy = true;
+    return package;
+}
 
-        if (subDir.path() != subDir.canonicalPath()) {
-            hash.addData(subDir.canonicalPath().toUtf8());
-        } else {
-            updateHash(basePath, relativePath, subDir, hash);
-        }
+void PackagePrivate::ensureInitialized()
+{
+    if (!lazy) {
+        return;
     }
+    // cleared first, the structure calls back into the package while it sets it up
+    lazy = false;
+
+    // set up a regular package and take over its state, so that all the copies sharing
+    // this data get the result and the structure ends up with a package it can modify freely
+    Package package(structure.data());
+    package.setPath(lazyPath);
+    lazyPath.clear();
+
+    *this = *package.d;
+    discoveries = package.d->discoveries;
+    entries = package.d->entries;
+    checkedValid = package.d->checkedValid;
 }
 
 void PackagePrivate::createPackageMetadata(const QString &path)
 {
+    const Instrumentation::Span span(Instrumentation::MetadataParse, path);
     if (QFileInfo(path).isDir()) {
         if (const QString jsonPath = path + QLatin1String("/metadata.json"); QFileInfo::exists(jsonPath)) {
             metadata = KPluginMetaData::fromJsonFile(jsonPath);
@@ -865,39 +963,159 @@ void PackagePrivate::createPackageMetadata(const QString &path)
     }
 }
 
+const PackageManifest *PackagePrivate::manifest() const
+{
+    if (loadedManifestPath != path) {
+        loadedManifestPath = path;
+        loadedManifest = path.isEmpty() ? nullptr : PackageManifest::load(path);
+    }
+    return loadedManifest.get();
+}
+
+std::optional<QString> PackagePrivate::manifestPath(const QString &file) const
+{
+    if (!file.startsWith(path)) {
+        return std::nullopt;
+    }
+    QString relativePath = file.mid(path.size());
+    while (relativePath.endsWith(QLatin1Char('/'))) {
+        relativePath.chop(1);
+    }
+    // the manifest only knows the plain paths, anything with "." or ".." is left to the filesystem
+    const auto segments = QStringView(relativePath).split(QLatin1Char('/'));
+    for (QStringView segment : segments) {
+        if (segment.isEmpty() || segment == QLatin1String(".") || segment == QLatin1String("..")) {
+            return std::nullopt;
+        }
+    }
+    return relativePath;
+}
+
 QString PackagePrivate::fallbackFilePath(const QByteArray &key, const QString &filename) const
 {
-    // don't fallback if the package isn't valid and never fallback the metadata file
-    if (key != "metadata" && fallbackPackage && fallbackPackage->isValid()) {
-        return fallbackPackage->filePath(key, filename);
-    } else {
+    // never fallback the metadata file
+    if (key == "metadata") {
         return QString();
     }
+    // the chain is looked into directly, the result ends up in the discoveries of this package only
+    const QList<const PackagePrivate *> chain = fallbackChain();
+    for (const PackagePrivate *fallback : chain) {
+        if (const QString file = fallback->findFilePath(key, filename); !file.isEmpty()) {
+            return file;
+        }
+    }
+    return QString();
 }
 
-bool PackagePrivate::hasCycle(const KPackage::Package &package)
+QList<const PackagePrivate *> PackagePrivate::fallbackChain() const
 {
-    if (!package.d->fallbackPackage) {
-        return false;
+    QList<const PackagePrivate *> chain;
+    QSet<const PackagePrivate *> visited{this};
+    QSet<QString> roots{fallbackId()};
+    for (const Package *fallback = fallbackPackage.get(); fallback; fallback = fallback->d->fallbackPackage.get()) {
+        // don't fallback if the package isn't valid, as filePath of an invalid package would find nothing further
+        if (!fallback->isValid() || visited.contains(fallback->d.data())) {
+            break;
+        }
+        visited.insert(fallback->d.data());
+        if (!roots.contains(fallback->d->fallbackId())) {
+            roots.insert(fallback->d->fallbackId());
+            chain << fallback->d.data();
+        }
     }
+    return chain;
+}
 
-    // This is the Floyd cycle detection algorithm
-    // http://en.wikipedia.org/wiki/Cycle_detection#Tortoise_and_hare
-    const KPackage::Package *slowPackage = &package;
-    const KPackage::Package *fastPackage = &package;
+QString PackagePrivate::fallbackId() const
+{
+    return path.isEmpty() ? QString::number(quintptr(this)) : path;
+}
 
-    while (fastPackage && fastPackage->d->fallbackPackage) {
-        // consider two packages the same if they have the same metadata
-        if ((fastPackage->d->fallbackPackage->metadata().isValid() && fastPackage->d->fallbackPackage->metadata() == slowPackage->metadata())
-            || (fastPackage->d->fallbackPackage->d->fallbackPackage && fastPackage->d->fallbackPackage->d->fallbackPackage->metadata().isValid()
-                && fastPackage->d->fallbackPackage->d->fallbackPackage->metadata() == slowPackage->metadata())) {
+bool PackagePrivate::hasCycle(const KPackage::Package &package) const
+{
+    QSet<const PackagePrivate *> visited;
+    for (const Package *p = &package; p; p = p->d->fallbackPackage.get()) {
+        // packages sharing their data are the same package, packages with the same path the same root
+        if (visited.contains(p->d.data()) || p->d->fallbackId() == fallbackId()) {
             qCWarning(KPACKAGE_LOG) << "Warning: the fallback chain of " << package.metadata().pluginId() << "contains a cyclical dependency.";
             return true;
         }
-        fastPackage = fastPackage->d->fallbackPackage->d->fallbackPackage.get();
-        slowPackage = slowPackage->d->fallbackPackage.get();
+        visited.insert(p->d.data());
     }
     return false;
 }
 
+Package PackagePrivate::detachedCopy(const Package &package)
+{
+    package.d->ensureInitialized();
+    QSet<const PackagePrivate *> copied;
+    return detachedCopy(package, copied);
+}
+
+Package PackagePrivate::detachedCopy(const Package &package, QSet<const PackagePrivate *> &copied)
+{
+    Package copy;
+    copy.d = new PackagePrivate(*package.d);
+    copy.d->discoveries = package.d->discoveries;
+    copy.d->checkedValid = package.d->checkedValid;
+    copied.insert(package.d.data());
+    // a cycle ends the fallback chain anyway
+    if (const Package *fallback = package.d->fallbackPackage.get(); fallback && !copied.contains(fallback->d.data())) {
+        fallback->d->ensureInitialized();
+        copy.d->fallbackPackage = std::make_unique<Package>(detachedCopy(*fallback, copied));
+    } else {
+        copy.d->fallbackPackage.reset();
+    }
+    return copy;
+}
+
+static void readAhead(const QString &filePath)
+{
+#if HAVE_POSIX_FADVISE
+    QFile file(filePath);
+    if (file.open(QIODevice::ReadOnly)) {
+        posix_fadvise(file.handle(), 0, 0, POSIX_FADV_WILLNEED);
+    }
+#else
+    Q_UNUSED(filePath)
+#endif
+}
+
+void PackagePrivate::prefetch(Package &package, const QList<QByteArray> &fileTypes)
+{
+    // checking the validity looks up all the required files and directories
+    if (!package.isValid()) {
+        return;
+    }
+
+    QList<QByteArray> files = package.requiredFiles();
+    for (const QByteArray &fileType : fileTypes) {
+        if (!files.contains(fileType)) {
+            files << fileType;
+        }
+    }
+    for (const QByteArray &fileType : std::as_const(files)) {
+        const QString filePath = package.filePath(fileType);
+        if (!filePath.isEmpty() && QFileInfo(filePath).isFile()) {
+            readAhead(filePath);
+        }
+    }
+}
+
+void PackagePrivate::takeDiscoveries(const Package &package, const Package &prefetched)
+{
+    // the package data gets detached before it changes, as the job holds on to it as well,
+    // so what the copy found out still applies to it
+    PackagePrivate *d = package.d.data();
+    for (auto it = prefetched.d->discoveries.cbegin(); it != prefetched.d->discoveries.cend(); ++it) {
+        if (!d->discoveries.contains(it.key())) {
+            d->discoveries.insert(it.key(), it.value());
+        }
+    }
+    if (!d->checkedValid && prefetched.d->checkedValid) {
+        d->valid = prefetched.d->valid;
+        d->checkedValid = true;
+    }
+}
+
 } // Namespace
@@ -56,6 +56,7 @@ namespace KPackage
  **/
 // TODO: write documentation on USING a package
 
+class PackagePrefetchJob;
 class PackagePrivate;
 class PackageStructure;
 
@@ -138,12 +139,44 @@ public:
     /**
      * Get the list of files of a given type.
      *
+     * The directories are listed on every call, use the overload taking
+     * options for a listing which is remembered.
+     *
      * @param fileType the type of file to look for, as defined in the
      *               package structure.
      * @return list of files by name, suitable for passing to filePath
      **/
     QStringList entryList(const QByteArray &key) const;
 
+    /**
+     * How entryList lists the files
+     * @since 6.13
+     */
+    enum EntryListOption {
+        NoEntryListOptions = 0x0,
+        FilterByMimeType = 0x1, ///< only the files matching the mimeTypes of the key are listed, judging by their names
+        SortByName = 0x2, ///< the files of all the paths of the key are sorted by name, instead of being listed path by path
+    };
+    Q_DECLARE_FLAGS(EntryListOptions, EntryListOption)
+
+    /**
+     * Get the list of files of a given type, or a page of it.
+     *
+     * Unlike entryList(key), the directories are listed on the first call only,
+     * until the path or the definitions of the package change: files added to
+     * the package meanwhile are not seen. It is cheap to call over and over,
+     * for instance to page through a directory with thousands of images.
+     *
+     * @param fileType the type of file to look for, as defined in the
+     *               package structure.
+     * @param options how to list the files
+     * @param offset the position of the first file to return
+     * @param count how many files to return at most, all of the remaining ones if negative
+     * @return list of files by name, suitable for passing to filePath
+     * @since 6.13
+     **/
+    QStringList entryList(const QByteArray &key, EntryListOptions options, qsizetype offset = 0, qsizetype count = -1) const;
+
     /**
      * @return true if the item at path exists and is required
      **/
@@ -306,11 +339,27 @@ public:
      */
     QList<QByteArray> requiredFiles() const;
 
+    /**
+     * Looks up the required files of the package and the files of @p fileTypes without blocking
+     * the calling thread, and asks the system to read them ahead. Once the job is finished
+     * filePath answers for them, and isValid, without touching the disk.
+     *
+     * Changing the package while the job runs is safe, the changed package just doesn't get what the job found out.
+     *
+     * @param fileTypes the files to look up besides the required ones, e.g. "mainscript"
+     * @return the job looking up the files, it is already started
+     * @see PackageLoader::prefetchPackages
+     * @since 6.13
+     */
+    PackagePrefetchJob *prefetch(const QList<QByteArray> &fileTypes = {}) const;
+
 private:
     QExplicitlySharedDataPointer<PackagePrivate> d;
     friend class PackagePrivate;
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(Package::EntryListOptions)
+
 }
 
 Q_DECLARE_METATYPE(KPackage::Package)
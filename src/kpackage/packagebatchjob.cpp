@@ -0,0 +1,296 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "packagebatchjob.h"
+
+#include "config-package.h"
+#include "package.h"
+#include "packageloader.h"
+#include "packagestructure.h"
+#include "private/dependencyresolver_p.h"
+#include "private/packageindex_p.h"
+#include "private/packagejobthread_p.h"
+
+#include "kpackage_debug.h"
+
+#if HAVE_QTDBUS
+#include <QDBusConnection>
+#include <QDBusMessage>
+#endif
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QPointer>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <utility>
+
+namespace KPackage
+{
+class PackageBatchJobPrivate
+{
+public:
+    struct Item {
+        QString source;
+        Package package;
+        // captured before the job runs, uninstalling wipes the metadata
+        QString pluginId;
+        QString packageRoot;
+        // owned by the thread pool once started
+        PackageJobThread *thread = nullptr;
+        int error = KJob::NoError;
+        QString errorText;
+    };
+
+    PackageJob::OperationType operation = PackageJob::Install;
+    QString packageFormat;
+    QList<Item> items;
+    qsizetype next = 0;
+    qsizetype running = 0;
+    qsizetype finished = 0;
+    bool started = false;
+};
+
+PackageBatchJob::PackageBatchJob(PackageJob::OperationType operation, const QString &packageFormat, const QStringList &sources, const QString &packageRoot)
+    : KJob()
+    , d(new PackageBatchJobPrivate)
+{
+    d->operation = operation;
+    d->packageFormat = packageFormat;
+    setTotalAmount(KJob::Items, sources.size());
+
+    PackageStructure *structure = PackageLoader::self()->loadPackageStructure(packageFormat);
+    if (!structure) {
+        setErrorText(QStringLiteral("Could not load package structure ") + packageFormat);
+        setError(PackageJob::JobError::InvalidPackageStructure);
+        return;
+    }
+
+    // dependencies shared by packages of the batch get installed once
+    const auto dependencyResolver = std::make_shared<DependencyResolver>();
+    d->items.reserve(sources.size());
+    for (const QString &source : sources) {
+        PackageBatchJobPrivate::Item item;
+        item.source = source;
+        item.package = Package(structure);
+        QString src;
+        QString dest;
+        if (operation == PackageJob::Uninstall) {
+            // see PackageJob::uninstall, an empty plugin id must not end up removing the package root
+            if (!source.isEmpty()) {
+                item.package.setPath(packageRoot + QLatin1Char('/') + source);
+            }
+            if (!item.package.path().isEmpty()) {
+                item.packageRoot = QFileInfo(QDir::cleanPath(item.package.path())).path();
+            }
+        } else {
+            item.package.setPath(source);
+            src = source;
+            dest = packageRoot.isEmpty() ? item.package.defaultPackageRoot() : packageRoot;
+            // use absolute paths if passed, otherwise go under share
+            if (!QDir::isAbsolutePath(dest)) {
+                dest = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QLatin1Char('/') + dest;
+            }
+            item.packageRoot = dest;
+        }
+        item.pluginId = item.package.metadata().pluginId();
+
+        // the index of the package roots gets updated once for the whole batch, see finish
+        item.thread = new PackageJobThread(operation, src, dest, item.package);
+        item.thread->setUpdateIndex(false);
+        item.thread->setDependencyResolver(dependencyResolver);
+        const int index = d->items.size();
+        connect(item.thread, &PackageJobThread::installPathChanged, this, [this, index](const QString &installPath) {
+            d->items[index].package.setPath(installPath);
+        });
+        connect(
+            item.thread,
+            &PackageJobThread::jobThreadFinished,
+            this,
+            [this, index](bool, PackageJob::JobError errorCode, const QString &errorMessage) {
+                packageThreadFinished(index, errorCode, errorMessage);
+            },
+            Qt::QueuedConnection);
+        d->items << item;
+    }
+}
+
+PackageBatchJob::~PackageBatchJob()
+{
+    for (const auto &item : std::as_const(d->items)) {
+        delete item.thread;
+    }
+}
+
+PackageBatchJob *PackageBatchJob::install(const QString &packageFormat, const QStringList &sourcePackages, const QString &packageRoot)
+{
+    auto job = new PackageBatchJob(PackageJob::Install, packageFormat, sourcePackages, packageRoot);
+    job->start();
+    return job;
+}
+
+PackageBatchJob *PackageBatchJob::update(const QString &packageFormat, const QStringList &sourcePackages, const QString &packageRoot)
+{
+    auto job = new PackageBatchJob(PackageJob::Update, packageFormat, sourcePackages, packageRoot);
+    job->start();
+    return job;
+}
+
+PackageBatchJob *PackageBatchJob::uninstall(const QString &packageFormat, const QStringList &pluginIds, const QString &packageRoot)
+{
+    auto job = new PackageBatchJob(PackageJob::Uninstall, packageFormat, pluginIds, packageRoot);
+    job->start();
+    return job;
+}
+
+void PackageBatchJob::start()
+{
+    if (d->started) {
+        qCWarning(KPACKAGE_LOG) << "The KPackage::PackageBatchJob was already started";
+        return;
+    }
+    d->started = true;
+
+    if (error() != KJob::NoError) {
+        QTimer::singleShot(0, this, [this]() {
+            emitResult();
+        });
+    } else if (d->items.isEmpty()) {
+        QTimer::singleShot(0, this, &PackageBatchJob::notifyFinished);
+    } else {
+        startNext();
+    }
+}
+
+void PackageBatchJob::startNext()
+{
+    // leaves room in the pool for the work the jobs spread themselves, e.g. copying files
+    QThreadPool *pool = QThreadPool::globalInstance();
+    const qsizetype maximumRunning = std::max(1, pool->maxThreadCount() / 2);
+    while (d->running < maximumRunning && d->next < d->items.size()) {
+        PackageJobThread *thread = std::exchange(d->items[d->next].thread, nullptr);
+        ++d->next;
+        ++d->running;
+        pool->start(thread);
+    }
+}
+
+void PackageBatchJob::packageThreadFinished(int index, PackageJob::JobError errorCode, const QString &errorMessage)
+{
+    auto &item = d->items[index];
+    if (errorCode != KJob::NoError) {
+        item.error = errorCode;
+        item.errorText = errorMessage;
+    }
+    --d->running;
+    ++d->finished;
+    setProcessedAmount(KJob::Items, d->finished);
+    Q_EMIT packageFinished(index);
+
+    if (d->finished == d->items.size()) {
+        finish();
+    } else {
+        startNext();
+    }
+}
+
+void PackageBatchJob::finish()
+{
+    QStringList roots;
+    for (const auto &item : std::as_const(d->items)) {
+        if (!item.packageRoot.isEmpty() && !roots.contains(item.packageRoot)) {
+            roots << item.packageRoot;
+        }
+    }
+    // the job may get killed and deleted while the indexes are updated: the pool thread doesn't touch it,
+    // whether it is still around is checked from the main thread, which is the one the job lives in
+    QPointer<PackageBatchJob> job(this);
+    QThreadPool::globalInstance()->start([job, roots]() {
+        for (const QString &root : roots) {
+            PackageIndex::update(root);
+        }
+        QMetaObject::invokeMethod(
+            QCoreApplication::instance(),
+            [job]() {
+                if (job) {
+                    job->notifyFinished();
+                }
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+void PackageBatchJob::notifyFinished()
+{
+    QStringList roots;
+    QStringList pluginIds;
+    for (const auto &item : std::as_const(d->items)) {
+        if (!item.packageRoot.isEmpty() && !roots.contains(item.packageRoot)) {
+            roots << item.packageRoot;
+        }
+        if (item.error == KJob::NoError) {
+            pluginIds << item.pluginId;
+        } else if (error() == KJob::NoError) {
+            setError(item.error);
+            setErrorText(item.errorText);
+        }
+    }
+
+    // even failed packages may have touched their package root
+    for (const QString &root : std::as_const(roots)) {
+        PackageLoader::invalidateCache(d->packageFormat, root);
+    }
+
+#if HAVE_QTDBUS
+    if (!pluginIds.isEmpty()) {
+        QString messageName;
+        if (d->operation == PackageJob::Install) {
+            messageName = QStringLiteral("packagesInstalled");
+        } else if (d->operation == PackageJob::Update) {
+            messageName = QStringLiteral("packagesUpdated");
+        } else {
+            messageName = QStringLiteral("packagesUninstalled");
+        }
+        auto msg = QDBusMessage::createSignal(QStringLiteral("/KPackage/") + d->packageFormat, QStringLiteral("org.kde.plasma.kpackage"), messageName);
+        msg.setArguments({pluginIds});
+        QDBusConnection::sessionBus().send(msg);
+    }
+#endif
+
+    emitResult();
+}
+
+int PackageBatchJob::count() const
+{
+    return d->items.size();
+}
+
+QString PackageBatchJob::source(int index) const
+{
+    return d->items.at(index).source;
+}
+
+Package PackageBatchJob::package(int index) const
+{
+    return d->items.at(index).package;
+}
+
+int PackageBatchJob::packageError(int index) const
+{
+    return d->items.at(index).error;
+}
+
+QString PackageBatchJob::packageErrorText(int index) const
+{
+    return d->items.at(index).errorText;
+}
+
+} // namespace KPackage
+
+#include "moc_packagebatchjob.cpp"
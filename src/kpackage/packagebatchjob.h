@@ -0,0 +1,95 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPACKAGE_PACKAGEBATCHJOB_H
+#define KPACKAGE_PACKAGEBATCHJOB_H
+
+#include <kpackage/package_export.h>
+#include <kpackage/packagejob.h>
+
+#include <KJob>
+#include <memory>
+
+namespace KPackage
+{
+class PackageBatchJobPrivate;
+class Package;
+
+/**
+ * @class PackageBatchJob kpackage/packagebatchjob.h <KPackage/PackageBatchJob>
+ * @short KJob subclass installing, updating or uninstalling many packages of one type at once
+ *
+ * The packages are processed concurrently, a few at a time. Compared to one PackageJob per package, the
+ * package structure is loaded once, and the package listings are invalidated and other processes are
+ * notified once for the whole batch.
+ *
+ * The job fails if any of the packages fails, with the error of the first one which did. The outcome
+ * for each package is available with packageError and packageErrorText.
+ *
+ * @since 6.13
+ */
+class KPACKAGE_EXPORT PackageBatchJob : public KJob
+{
+    Q_OBJECT
+
+public:
+    ~PackageBatchJob() override;
+    /// Installs the given packages. The returned job is already started
+    static PackageBatchJob *install(const QString &packageFormat, const QStringList &sourcePackages, const QString &packageRoot = QString());
+    /// Updates the given packages. The returned job is already started
+    static PackageBatchJob *update(const QString &packageFormat, const QStringList &sourcePackages, const QString &packageRoot = QString());
+    /// Uninstalls the given packages. The returned job is already started
+    static PackageBatchJob *uninstall(const QString &packageFormat, const QStringList &pluginIds, const QString &packageRoot = QString());
+
+    /**
+     * @return the number of packages of the batch
+     */
+    int count() const;
+
+    /**
+     * @return the source package or the plugin id at @p index, as given when creating the job
+     */
+    QString source(int index) const;
+
+    /**
+     * @return the package at @p index, set to its installed path once it is installed
+     */
+    KPackage::Package package(int index) const;
+
+    /**
+     * @return the error of the package at @p index, one of PackageJob::JobError or KJob::NoError
+     */
+    int packageError(int index) const;
+
+    /**
+     * @return the error text of the package at @p index, empty if it succeeded
+     */
+    QString packageErrorText(int index) const;
+
+Q_SIGNALS:
+    /**
+     * Emitted once the package at @p index is done with, whether it succeeded or not
+     */
+    void packageFinished(int index);
+
+private:
+    void start() override;
+
+    KPACKAGE_NO_EXPORT explicit PackageBatchJob(PackageJob::OperationType operation,
+                                                const QString &packageFormat,
+                                                const QStringList &sources,
+                                                const QString &packageRoot);
+    KPACKAGE_NO_EXPORT void startNext();
+    KPACKAGE_NO_EXPORT void packageThreadFinished(int index, PackageJob::JobError errorCode, const QString &errorMessage);
+    KPACKAGE_NO_EXPORT void finish();
+    KPACKAGE_NO_EXPORT void notifyFinished();
+
+    const std::unique_ptr<PackageBatchJobPrivate> d;
+};
+
+}
+
+#endif
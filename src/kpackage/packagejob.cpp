@@ -15,6 +15,7 @@
 #include "private/utils.h"
 
 #include "kpackage_debug.h"
+#include <KLocalizedString>
 
 #if HAVE_QTDBUS
 #include <QDBusConnection>
@@ -52,6 +53,11 @@ public:
     PackageJobThread *thread = nullptr;
     Package package;
     QString installPath;
+    // the root the job installs into or removes from, for the PackageLoader cache invalidation
+    QString packageRoot;
+    PackageJob::OperationType operation = PackageJob::Install;
+    QByteArray hash;
+    std::shared_ptr<std::atomic_bool> canceled = std::make_shared<std::atomic_bool>(false);
 };
 
 PackageJob::PackageJob(OperationType type, const Package &package, const QString &src, const QString &dest)
@@ -60,6 +66,12 @@ PackageJob::PackageJob(OperationType type, const Package &package, const QString
 {
     d->thread = new PackageJobThread(type, src, dest, package);
     d->package = package;
+    d->operation = type;
+    if (!dest.isEmpty()) {
+        d->packageRoot = dest;
+    } else if (!package.path().isEmpty()) {
+        d->packageRoot = QFileInfo(QDir::cleanPath(package.path())).path();
+    }
 
     connect(d->thread, &PackageJobThread::installPathChanged, this, [this](const QString &installPath) {
         d->package.setPath(installPath);
@@ -71,15 +83,42 @@ PackageJob::PackageJob(OperationType type, const Package &package, const QString
         setupNotificationsOnJobFinished(QStringLiteral("packageInstalled"));
     } else if (type == Update) {
         setupNotificationsOnJobFinished(QStringLiteral("packageUpdated"));
-        d->thread->update(src, dest, package);
     } else if (type == Uninstall) {
         setupNotificationsOnJobFinished(QStringLiteral("packageUninstalled"));
+    } else if (type == Verify) {
+        // nothing changed, there is nobody to notify
+        setCapabilities(Killable);
+        connect(d->thread, &PackageJobThread::hashingStarted, this, [this](qint64 totalBytes) {
+            setTotalAmount(Bytes, totalBytes);
+        });
+        connect(d->thread, &PackageJobThread::bytesHashed, this, [this](qint64 processedBytes) {
+            setProcessedAmount(Bytes, processedBytes);
+        });
+        connect(d->thread, &PackageJobThread::hashComputed, this, [this](const QByteArray &hash) {
+            d->hash = hash;
+        });
+        connect(
+            d->thread,
+            &PackageJobThread::jobThreadFinished,
+            this,
+            [this](bool ok, JobError errorCode, const QString &error) {
+                if (!ok) {
+                    setError(errorCode);
+                    setErrorText(error);
+                }
+                emitResult();
+            },
+            Qt::QueuedConnection);
     } else {
         Q_UNREACHABLE();
     }
 }
 
-PackageJob::~PackageJob() = default;
+PackageJob::~PackageJob()
+{
+    // once started the thread pool owns it
+    delete d->thread;
+}
 
 void PackageJob::start()
 {
@@ -98,7 +137,6 @@ PackageJob *PackageJob::install(const QString &packageFormat, const QString &sou
         Package package(structure);
         package.setPath(sourcePackage);
         QString dest = packageRoot.isEmpty() ? package.defaultPackageRoot() : packageRoot;
-        PackageLoader::invalidateCache();
 
         // use absolute paths if passed, otherwise go under share
         if (!QDir::isAbsolutePath(dest)) {
@@ -119,7 +157,6 @@ PackageJob *PackageJob::update(const QString &packageFormat, const QString &sour
         Package package(structure);
         package.setPath(sourcePackage);
         QString dest = packageRoot.isEmpty() ? package.defaultPackageRoot() : packageRoot;
-        PackageLoader::invalidateCache();
 
         // use absolute paths if passed, otherwise go under share
         if (!QDir::isAbsolutePath(dest)) {
@@ -147,7 +184,6 @@ PackageJob *PackageJob::uninstall(const QString &packageFormat, const QString &p
         }
         package.setPath(uninstallPath);
 
-        PackageLoader::invalidateCache();
         auto job = new PackageJob(Uninstall, package, QString(), QString());
         job->start();
         return job;
@@ -156,18 +192,55 @@ PackageJob *PackageJob::uninstall(const QString &packageFormat, const QString &p
     }
 }
 
+PackageJob *PackageJob::verify(const KPackage::Package &package, const QByteArray &expectedHash, QCryptographicHash::Algorithm algorithm)
+{
+    Package verifiedPackage = package;
+    auto job = new PackageJob(Verify, verifiedPackage, QString(), QString());
+    // checked here, the package must not be used from the thread
+    if (!verifiedPackage.isValid()) {
+        job->setErrorText(i18n("Package is not considered valid"));
+        job->setError(PackageJob::JobError::InvalidPackageStructure);
+        QTimer::singleShot(0, job, [job]() {
+            job->emitResult();
+        });
+        return job;
+    }
+    job->d->thread->setVerification(algorithm, expectedHash, job->d->canceled);
+    job->start();
+    return job;
+}
+
 KPackage::Package PackageJob::package() const
 {
     return d->package;
 }
+
+QByteArray PackageJob::hash() const
+{
+    return d->hash;
+}
+
+bool PackageJob::doKill()
+{
+    // installing and removing packages isn't interruptible
+    if (d->operation != Verify) {
+        return false;
+    }
+    *d->canceled = true;
+    return true;
+}
 void PackageJob::setupNotificationsOnJobFinished(const QString &messageName)
 {
     // capture first as uninstalling wipes d->package
     // or d-package can become dangling during the job if deleted externally
     const QString pluginId = d->package.metadata().pluginId();
     const QString kpackageType = readKPackageType(d->package.metadata());
+    const QString packageRoot = d->packageRoot;
 
     auto onJobFinished = [=, this](bool ok, JobError errorCode, const QString &error) {
+        // even a failed job may have touched the package root, e.g. an update which
+        // removed the old version but could not copy the new one
+        PackageLoader::invalidateCache(kpackageType, packageRoot);
 #if HAVE_QTDBUS
         if (ok) {
             auto msg = QDBusMessage::createSignal(QStringLiteral("/KPackage/") + kpackageType, QStringLiteral("org.kde.plasma.kpackage"), messageName);
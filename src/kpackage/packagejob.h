@@ -11,6 +11,7 @@
 #include <kpackage/package_export.h>
 
 #include <KJob>
+#include <QCryptographicHash>
 #include <memory>
 
 namespace KPackage
@@ -46,6 +47,8 @@ public:
         PackageMoveError, /**< Failure to move a package from the system temporary folder to its final destination */
         PackageCopyError, /**< Failure to copy a package folder from somewhere in the filesystem to its final destination */
         PackageUninstallError, /**< Failure to uninstall a package */
+        PackageHashError, /**< Failure to compute the hash of a package, @since 6.13 */
+        PackageHashMismatchError, /**< The hash of a package is different from the expected one, @since 6.13 */
     };
 
     ~PackageJob() override;
@@ -56,14 +59,37 @@ public:
     /// Installs the given package. The returned job is already started
     static PackageJob *uninstall(const QString &packageFormat, const QString &pluginId, const QString &packageRoot = QString());
 
+    /**
+     * Computes the hash of @p package, see Package::cryptographicHash, on the thread pool.
+     * The job reports its progress in bytes and can be killed.
+     *
+     * @param expectedHash the hex encoded hash the package should have, e.g. as published along with it.
+     * If not empty and the hash is different, the job fails with PackageHashMismatchError
+     * @return the job, which is already started
+     * @since 6.13
+     */
+    static PackageJob *
+    verify(const KPackage::Package &package, const QByteArray &expectedHash = QByteArray(), QCryptographicHash::Algorithm algorithm = QCryptographicHash::Sha1);
+
     KPackage::Package package() const;
 
+    /**
+     * @return the hex encoded hash computed by a verify job, empty until it is finished
+     * @since 6.13
+     */
+    QByteArray hash() const;
+
+protected:
+    bool doKill() override;
+
 private:
+    friend class PackageBatchJob;
     friend class PackageJobThread;
     enum OperationType {
         Install,
         Update,
         Uninstall,
+        Verify,
     };
     void start() override;
 
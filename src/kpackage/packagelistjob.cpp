@@ -0,0 +1,132 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "packagelistjob.h"
+
+#include "packageloader.h"
+#include "private/packagelistjobthread_p.h"
+#include "private/packageloader_p.h"
+
+#include "kpackage_debug.h"
+
+#include <QThreadPool>
+#include <QTimer>
+
+namespace KPackage
+{
+class PackageListJobPrivate
+{
+public:
+    QString cacheKey;
+    PackageLoaderPrivate::CachedListing listing;
+    std::function<bool(const KPluginMetaData &)> filter;
+    QList<KPluginMetaData> packages;
+    PackageListJobThread *thread = nullptr;
+    std::shared_ptr<std::atomic_bool> canceled = std::make_shared<std::atomic_bool>(false);
+    // the listing came from the cache of PackageLoader, there is nothing left to scan
+    bool complete = false;
+    bool started = false;
+};
+
+PackageListJob::PackageListJob(const QString &packageFormat, const QString &packageRoot, const std::function<bool(const KPluginMetaData &)> &filter)
+    : KJob()
+    , d(new PackageListJobPrivate)
+{
+    PackageLoader *loader = PackageLoader::self();
+    d->cacheKey = PackageLoaderPrivate::cacheKey(packageFormat, packageRoot);
+    d->filter = filter;
+    if (const auto listing = loader->d->upToDateListing(d->cacheKey)) {
+        d->listing = *listing;
+        d->complete = true;
+        return;
+    }
+    loader->d->setupNotifications();
+    d->listing = PackageLoaderPrivate::prepareListing(loader, packageFormat, packageRoot);
+
+    d->thread = new PackageListJobThread(packageFormat, d->listing.roots, d->canceled);
+    connect(
+        d->thread,
+        &PackageListJobThread::packagesFound,
+        this,
+        [this](const MetadataTable &packages) {
+            for (qsizetype i = 0; i < packages.size(); ++i) {
+                d->listing.packages.append(packages, i);
+            }
+            addPackages(packages.toList());
+        },
+        Qt::QueuedConnection);
+    connect(
+        d->thread,
+        &PackageListJobThread::listingFinished,
+        this,
+        [this]() {
+            PackageLoader::self()->d->publishListing(d->cacheKey, d->listing);
+            emitResult();
+        },
+        Qt::QueuedConnection);
+}
+
+PackageListJob::~PackageListJob()
+{
+    *d->canceled = true;
+    // once started the thread pool owns it
+    if (!d->started) {
+        delete d->thread;
+    }
+}
+
+void PackageListJob::start()
+{
+    if (d->started) {
+        qCWarning(KPACKAGE_LOG) << "The KPackage::PackageListJob was already started";
+        return;
+    }
+    d->started = true;
+
+    if (d->complete) {
+        // the caller needs a chance to connect to the signals first
+        QTimer::singleShot(0, this, [this]() {
+            addPackages(d->listing.toList());
+            emitResult();
+        });
+    } else {
+        QThreadPool::globalInstance()->start(d->thread);
+    }
+}
+
+QList<KPluginMetaData> PackageListJob::packages() const
+{
+    return d->packages;
+}
+
+bool PackageListJob::doKill()
+{
+    *d->canceled = true;
+    return true;
+}
+
+void PackageListJob::addPackages(const QList<KPluginMetaData> &packages)
+{
+    QList<KPluginMetaData> accepted;
+    if (d->filter) {
+        for (const KPluginMetaData &package : packages) {
+            if (d->filter(package)) {
+                accepted << package;
+            }
+        }
+    } else {
+        accepted = packages;
+    }
+
+    if (!accepted.isEmpty()) {
+        d->packages += accepted;
+        Q_EMIT packagesFound(accepted);
+    }
+}
+
+} // namespace KPackage
+
+#include "moc_packagelistjob.cpp"
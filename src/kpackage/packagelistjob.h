@@ -0,0 +1,71 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPACKAGE_PACKAGELISTJOB_H
+#define KPACKAGE_PACKAGELISTJOB_H
+
+#include <kpackage/package_export.h>
+
+#include <KJob>
+#include <KPluginMetaData>
+
+#include <functional>
+#include <memory>
+
+namespace KPackage
+{
+class PackageListJobPrivate;
+class PackageLoader;
+
+/**
+ * @class PackageListJob kpackage/packagelistjob.h <KPackage/PackageListJob>
+ * @short KJob subclass listing the available packages of a certain type without blocking
+ *
+ * The jobs are created by PackageLoader::listPackagesAsync.
+ *
+ * @code
+ * auto job = KPackage::PackageLoader::self()->listPackagesAsync(QStringLiteral("Plasma/Applet"));
+ * connect(job, &KPackage::PackageListJob::packagesFound, model, &AppletModel::appendApplets);
+ * @endcode
+ *
+ * @since 6.13
+ */
+class KPACKAGE_EXPORT PackageListJob : public KJob
+{
+    Q_OBJECT
+
+public:
+    ~PackageListJob() override;
+
+    /**
+     * @return the packages found so far, all of them once the job is finished
+     */
+    QList<KPluginMetaData> packages() const;
+
+Q_SIGNALS:
+    /**
+     * Emitted for each batch of packages found, in the order PackageLoader::listPackages would return them
+     */
+    void packagesFound(const QList<KPluginMetaData> &packages);
+
+protected:
+    bool doKill() override;
+
+private:
+    friend class PackageLoader;
+    void start() override;
+
+    KPACKAGE_NO_EXPORT explicit PackageListJob(const QString &packageFormat,
+                                               const QString &packageRoot,
+                                               const std::function<bool(const KPluginMetaData &)> &filter);
+    KPACKAGE_NO_EXPORT void addPackages(const QList<KPluginMetaData> &packages);
+
+    const std::unique_ptr<PackageListJobPrivate> d;
+};
+
+}
+
+#endif
@@ -11,24 +11,225 @@
 #include "kpackage_debug.h"
 #include <QCoreApplication>
 #include <QDateTime>
-#include <QDirIterator>
+#include <QDir>
+#include <QFileInfo>
 #include <QList>
 #include <QStandardPaths>
+#include <QThread>
+
+#include <algorithm>
+
+#if HAVE_QTDBUS
+#include <QDBusConnection>
+#include <QDBusMessage>
+#endif
 
 #include <KLazyLocalizedString>
 #include <KPluginFactory>
 #include <KPluginMetaData>
-#include <unordered_set>
+#include <chrono>
 
 #include "config-package.h"
 
 #include "package.h"
+#include "packagelistjob.h"
+#include "packageprefetchjob.h"
 #include "packagestructure.h"
+#include "private/instrumentation_p.h"
+#include "private/package_p.h"
+#include "private/packageindex_p.h"
 #include "private/packagejobthread_p.h"
 #include "private/packages_p.h"
+#include "private/parallel_p.h"
 
 namespace KPackage
 {
+#if HAVE_QTDBUS
+class PackageCacheNotifier : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PackageCacheNotifier(PackageLoaderPrivate *loader)
+        : m_loader(loader)
+    {
+        // sent by PackageJob::setupNotificationsOnJobFinished and PackageBatchJob, possibly from another process
+        const QStringList signalNames{QStringLiteral("packageInstalled"),
+                                      QStringLiteral("packageUpdated"),
+                                      QStringLiteral("packageUninstalled"),
+                                      QStringLiteral("packagesInstalled"),
+                                      QStringLiteral("packagesUpdated"),
+                                      QStringLiteral("packagesUninstalled")};
+        for (const QString &signalName : signalNames) {
+            QDBusConnection::sessionBus()
+                .connect(QString(), QString(), QStringLiteral("org.kde.plasma.kpackage"), signalName, this, SLOT(packageChanged(QDBusMessage)));
+        }
+    }
+
+private Q_SLOTS:
+    void packageChanged(const QDBusMessage &message)
+    {
+        // the object path is "/KPackage/" followed by the package type
+        const QString kpackageType = message.path().mid(QLatin1String("/KPackage/").size());
+        if (!kpackageType.isEmpty()) {
+            m_loader->invalidateFormat(kpackageType);
+        }
+    }
+
+private:
+    PackageLoaderPrivate *const m_loader;
+};
+#endif
+
+qint64 PackageLoaderPrivate::rootModificationTime(const QString &root)
+{
+    const QFileInfo info(root);
+    return info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+}
+
+// a stat() per package is too much for every listPackages call of a process listing the same packages over and over
+static constexpr std::chrono::milliseconds s_packagesCheckInterval{1000};
+
+bool PackageLoaderPrivate::CachedListing::isUpToDate() const
+{
+    for (qsizetype i = 0; i < roots.size(); ++i) {
+        if (rootModificationTime(roots.at(i)) != rootModificationTimes.at(i)) {
+            return false;
+        }
+    }
+
+    // packages updated in place, see PackageIndex, only one of the threads using the listing checks them
+    const qint64 now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    qint64 checkedAt = lookups->packagesCheckedAt.load();
+    if (checkedAt != 0 && now - checkedAt < s_packagesCheckInterval.count()) {
+        return true;
+    }
+    if (!lookups->packagesCheckedAt.compare_exchange_strong(checkedAt, now)) {
+        return true;
+    }
+    return packages.isUpToDate();
+}
+
+QStringList PackageLoaderPrivate::packageRoots(const QString &packageRoot)
+{
+    if (QDir::isAbsolutePath(packageRoot)) {
+        return QStringList(packageRoot);
+    }
+    QStringList paths;
+    const auto listPath = QStandardPaths::standardLocations(QStandardPaths::GenericDataLocation);
+    for (const QString &path : listPath) {
+        paths += path + QLatin1Char('/') + packageRoot;
+    }
+    return paths;
+}
+
+QString PackageLoaderPrivate::cacheKey(const QString &packageFormat, const QString &packageRoot)
+{
+    return packageFormat + QLatin1Char('.') + packageRoot;
+}
+
+MetadataTable PackageLoaderPrivate::mergeEntries(const QString &packageFormat, const MetadataTable &entries, QSet<QString> &uniqueIds)
+{
+    MetadataTable lst;
+    for (qsizetype i = 0; i < entries.size(); ++i) {
+        const QString pluginId = entries.pluginId(i);
+        if (uniqueIds.contains(pluginId)) {
+            continue;
+        }
+
+        if (packageFormat.isEmpty() || entries.packageFormat(i) == packageFormat) {
+            uniqueIds << pluginId;
+            lst.append(entries, i);
+        } else {
+            qInfo() << "KPackageStructure of" << entries.path(i) << "does not match requested format" << packageFormat;
+        }
+    }
+    return lst;
+}
+
+std::shared_ptr<const PackageLoaderPrivate::CachedListing> PackageLoaderPrivate::upToDateListing(const QString &cacheKey)
+{
+    std::shared_ptr<const CachedListing> listing = state.load()->pluginCache.value(cacheKey);
+    if (!listing) {
+        Instrumentation::count(Instrumentation::ListingCacheMisses);
+        return nullptr;
+    }
+    // a few stats to notice packages added or removed behind our back, by the package manager for instance
+    if (listing->isUpToDate()) {
+        Instrumentation::count(Instrumentation::ListingCacheHits);
+        return listing;
+    }
+    Instrumentation::count(Instrumentation::ListingCacheMisses);
+    state.update([&cacheKey, &listing](State &snapshot) {
+        // unless another thread got there first
+        if (snapshot.pluginCache.value(cacheKey) != listing) {
+            return false;
+        }
+        snapshot.pluginCache.remove(cacheKey);
+        return true;
+    });
+    return nullptr;
+}
+
+void PackageLoaderPrivate::invalidateFormat(const QString &packageFormat)
+{
+    state.update([&packageFormat](State &snapshot) {
+        // listings without format filter may contain packages of any type
+        return snapshot.pluginCache.removeIf([&packageFormat](const QHash<QString, std::shared_ptr<const CachedListing>>::iterator it) {
+            return it.value()->packageFormat == packageFormat || it.value()->packageFormat.isEmpty();
+        }) > 0;
+    });
+}
+
+void PackageLoaderPrivate::invalidateRoot(const QString &packageRoot)
+{
+    const QString root = QDir::cleanPath(packageRoot);
+    state.update([&root](State &snapshot) {
+        return snapshot.pluginCache.removeIf([&root](const QHash<QString, std::shared_ptr<const CachedListing>>::iterator it) {
+            return it.value()->roots.contains(root);
+        }) > 0;
+    });
+}
+
+std::shared_ptr<const PackageLoaderPrivate::CachedListing> PackageLoaderPrivate::publishListing(const QString &cacheKey, CachedListing listing)
+{
+    listing.buildIndex();
+    auto published = std::make_shared<const CachedListing>(std::move(listing));
+    state.update([&cacheKey, &published](State &snapshot) {
+        snapshot.pluginCache.insert(cacheKey, published);
+        return true;
+    });
+    return published;
+}
+
+PackageStructure *PackageLoaderPrivate::publishStructure(const QString &packageFormat, PackageStructure *structure, bool replace)
+{
+    PackageStructure *result = structure;
+    state.update([&](State &snapshot) {
+        if (PackageStructure *current = snapshot.structures.value(packageFormat).data(); current && !replace) {
+            result = current;
+            return false;
+        }
+        snapshot.structures.insert(packageFormat, structure);
+        return true;
+    });
+    if (result != structure) {
+        delete structure;
+    }
+    return result;
+}
+
+void PackageLoaderPrivate::setupNotifications()
+{
+#if HAVE_QTDBUS
+    QCoreApplication *app = QCoreApplication::instance();
+    // the notifier needs an event loop, so it only gets created from the main thread
+    if (notifier || !app || QThread::currentThread() != app->thread()) {
+        return;
+    }
+    notifier = new PackageCacheNotifier(this);
+#endif
+}
+
 PackageLoader::PackageLoader()
     : d(new PackageLoaderPrivate)
 {
@@ -36,9 +237,12 @@ PackageLoader::PackageLoader()
 
 PackageLoader::~PackageLoader()
 {
-    for (auto wp : std::as_const(d->structures)) {
+    for (auto wp : std::as_const(d->state.load()->structures)) {
         delete wp.data();
     }
+#if HAVE_QTDBUS
+    delete d->notifier;
+#endif
     delete d;
 }
 
@@ -57,7 +261,14 @@ Package PackageLoader::loadPackage(const QString &packageFormat, const QString &
     if (PackageStructure *structure = loadPackageStructure(packageFormat)) {
         Package p(structure);
         if (!packagePath.isEmpty()) {
-            p.setPath(packagePath);
+            // a plugin id is usually answered by the listing, without searching all the data directories
+            const QString indexedPath = d->indexedPackagePath(this, p, packageFormat, packagePath);
+            if (!indexedPath.isEmpty()) {
+                p.setPath(indexedPath);
+            }
+            if (indexedPath.isEmpty() || !p.isValid()) {
+                p.setPath(packagePath);
+            }
         }
         return p;
     }
@@ -72,21 +283,14 @@ QList<Package> PackageLoader::listKPackages(const QString &packageFormat, const
     // has been a root specified?
     QString actualRoot = packageRoot;
 
-    PackageStructure *structure = d->structures.value(packageFormat).data();
+    PackageStructure *structure = d->state.load()->structures.value(packageFormat).data();
     // try to take it from the package structure
     if (actualRoot.isEmpty()) {
         if (!structure) {
-            if (packageFormat == QLatin1String("KPackage/Generic")) {
-                structure = new GenericPackage();
-            } else if (packageFormat == QLatin1String("KPackage/GenericQML")) {
-                structure = new GenericQMLPackage();
-            } else {
-                structure = loadPackageStructure(packageFormat);
-            }
+            structure = loadPackageStructure(packageFormat);
         }
 
         if (structure) {
-            d->structures.insert(packageFormat, structure);
             actualRoot = Package(structure).defaultPackageRoot();
         }
     }
@@ -95,26 +299,18 @@ QList<Package> PackageLoader::listKPackages(const QString &packageFormat, const
         actualRoot = packageFormat;
     }
 
-    QStringList paths;
-    if (QDir::isAbsolutePath(actualRoot)) {
-        paths = QStringList(actualRoot);
-    } else {
-        const auto listPath = QStandardPaths::standardLocations(QStandardPaths::GenericDataLocation);
-        for (const QString &path : listPath) {
-            paths += path + QLatin1Char('/') + actualRoot;
-        }
-    }
+    const QStringList paths = PackageLoaderPrivate::packageRoots(actualRoot);
 
-    for (auto const &plugindir : std::as_const(paths)) {
-        QDirIterator it(plugindir, QDir::Dirs | QDir::NoDotAndDotDot);
-        std::unordered_set<QString> dirs;
-        while (it.hasNext()) {
-            it.next();
+    // the roots can be on slow mounts, so list them all at once
+    QList<QStringList> directories(paths.size());
+    QStringList *output = directories.data();
+    parallelFor(paths.size(), [&paths, output](qsizetype i) {
+        output[i] = QDir(paths.at(i)).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    });
 
-            const QString dir = it.filePath();
-            if (!dirs.insert(it.fileInfo().fileName()).second) {
-                continue;
-            }
+    for (qsizetype i = 0; i < paths.size(); ++i) {
+        for (const QString &dirName : std::as_const(directories.at(i))) {
+            const QString dir = paths.at(i) + QLatin1Char('/') + dirName;
             Package package(structure);
             package.setPath(dir);
             if (package.isValid()) {
@@ -129,48 +325,34 @@ QList<Package> PackageLoader::listKPackages(const QString &packageFormat, const
     }
     return lst;
 }
-QList<KPluginMetaData> PackageLoader::listPackages(const QString &packageFormat, const QString &packageRoot)
+QList<Package> PackageLoader::listKPackagesLazily(const QString &packageFormat, const QString &packageRoot)
 {
-    // Note: Use QDateTime::currentSecsSinceEpoch() once we can depend on Qt 5.8
-    const qint64 now = qRound64(QDateTime::currentMSecsSinceEpoch() / 1000.0);
-    bool useRuntimeCache = true;
-    if (now - d->pluginCacheAge > d->maxCacheAge && d->pluginCacheAge != 0) {
-        // cache is old and we're not within a few seconds of startup anymore
-        useRuntimeCache = false;
-        d->pluginCache.clear();
+    QList<Package> lst;
+    PackageStructure *structure = packageFormat.isEmpty() ? nullptr : loadPackageStructure(packageFormat);
+    if (!structure) {
+        return lst;
     }
 
-    const QString cacheKey = packageFormat + QLatin1Char('.') + packageRoot;
-    if (useRuntimeCache) {
-        auto it = d->pluginCache.constFind(cacheKey);
-        if (it != d->pluginCache.constEnd()) {
-            return *it;
+    const QList<KPluginMetaData> packages = listPackages(packageFormat, packageRoot);
+    lst.reserve(packages.size());
+    for (const KPluginMetaData &metadata : packages) {
+        // hidden packages are never valid, that much is known without looking at them
+        if (metadata.value(QStringLiteral("isHidden"), QStringLiteral("false")) == QLatin1String("true")) {
+            continue;
         }
+        lst << PackagePrivate::createLazyPackage(structure, QFileInfo(metadata.fileName()).path(), metadata);
     }
-    if (d->pluginCacheAge == 0) {
-        d->pluginCacheAge = now;
-    }
-
-    QList<KPluginMetaData> lst;
+    return lst;
+}
 
+PackageLoaderPrivate::CachedListing PackageLoaderPrivate::prepareListing(PackageLoader *loader, const QString &packageFormat, const QString &packageRoot)
+{
     // has been a root specified?
     QString actualRoot = packageRoot;
 
     // try to take it from the package structure
     if (actualRoot.isEmpty()) {
-        PackageStructure *structure = d->structures.value(packageFormat).data();
-        if (!structure) {
-            if (packageFormat == QLatin1String("KPackage/Generic")) {
-                structure = new GenericPackage();
-            } else if (packageFormat == QLatin1String("KPackage/GenericQML")) {
-                structure = new GenericQMLPackage();
-            } else {
-                structure = loadPackageStructure(packageFormat);
-            }
-        }
-
-        if (structure) {
-            d->structures.insert(packageFormat, structure);
+        if (PackageStructure *structure = loader->loadPackageStructure(packageFormat)) {
             Package p(structure);
             actualRoot = p.defaultPackageRoot();
         }
@@ -180,50 +362,266 @@ QList<KPluginMetaData> PackageLoader::listPackages(const QString &packageFormat,
         actualRoot = packageFormat;
     }
 
+    const QStringList paths = PackageLoaderPrivate::packageRoots(actualRoot);
+
+    PackageLoaderPrivate::CachedListing listing;
+    listing.packageFormat = packageFormat;
+    listing.roots.reserve(paths.size());
+    listing.rootModificationTimes.reserve(paths.size());
+    for (auto const &plugindir : paths) {
+        listing.roots << QDir::cleanPath(plugindir);
+        // taken before scanning, a change during the scan makes the listing outdated right away
+        listing.rootModificationTimes << PackageLoaderPrivate::rootModificationTime(listing.roots.constLast());
+    }
+    return listing;
+}
+
+std::shared_ptr<const PackageLoaderPrivate::CachedListing>
+PackageLoaderPrivate::listing(PackageLoader *loader, const QString &packageFormat, const QString &packageRoot)
+{
+    const QString key = cacheKey(packageFormat, packageRoot);
+    if (auto cached = upToDateListing(key)) {
+        return cached;
+    }
+    setupNotifications();
+
+    CachedListing listing = prepareListing(loader, packageFormat, packageRoot);
+    mergeRoots(listing, readRoots(listing.roots));
+
+    // threads missing the cache at the same time each gather the listing, the last one stays cached
+    return publishListing(key, std::move(listing));
+}
+
+QHash<QString, MetadataTable> PackageLoaderPrivate::readRoots(const QStringList &roots)
+{
+    // each root is read on its own thread, slow mounts then don't add up
+    QList<MetadataTable> entriesPerRoot(roots.size());
+    MetadataTable *output = entriesPerRoot.data();
+    parallelFor(roots.size(), [&roots, output](qsizetype i) {
+        output[i] = PackageIndex::entries(roots.at(i));
+    });
+
+    QHash<QString, MetadataTable> result;
+    for (qsizetype i = 0; i < roots.size(); ++i) {
+        result.insert(roots.at(i), entriesPerRoot.at(i));
+    }
+    return result;
+}
+
+void PackageLoaderPrivate::mergeRoots(CachedListing &listing, const QHash<QString, MetadataTable> &entriesPerRoot)
+{
+    // merged in the order of the roots, so that the first one providing a plugin id wins
     QSet<QString> uniqueIds;
-    QStringList paths;
-    if (QDir::isAbsolutePath(actualRoot)) {
-        paths = QStringList(actualRoot);
-    } else {
-        const auto listPath = QStandardPaths::standardLocations(QStandardPaths::GenericDataLocation);
-        for (const QString &path : listPath) {
-            paths += path + QLatin1Char('/') + actualRoot;
+    for (const QString &root : std::as_const(listing.roots)) {
+        const MetadataTable merged = mergeEntries(listing.packageFormat, entriesPerRoot.value(root), uniqueIds);
+        for (qsizetype i = 0; i < merged.size(); ++i) {
+            listing.packages.append(merged, i);
         }
     }
+}
 
-    for (auto const &plugindir : std::as_const(paths)) {
-        QDirIterator it(plugindir, QStringList{QStringLiteral("metadata.json")}, QDir::Files, QDirIterator::Subdirectories);
-        std::unordered_set<QString> dirs;
-        while (it.hasNext()) {
-            it.next();
+QString PackageLoaderPrivate::indexedPackagePath(PackageLoader *loader, const Package &package, const QString &packageFormat, const QString &pluginId)
+{
+    // only relative paths are looked up in the default package root, which is what the listing covers
+    if (!QDir::isRelativePath(pluginId) || pluginId.contains(QLatin1Char('/')) || package.defaultPackageRoot().isEmpty()) {
+        return QString();
+    }
+    const std::shared_ptr<const CachedListing> cached = listing(loader, packageFormat, QString());
+    if (std::optional<QString> path = cached->canonicalPath(pluginId)) {
+        return *path;
+    }
 
-            const QString dir = it.fileInfo().absoluteDir().path();
-            if (!dirs.insert(dir).second) {
-                continue;
-            }
+    QString path;
+    // no need to decode the metadata, the first package with the plugin id is the one
+    const QList<qsizetype> matches = cached->pluginIds.value(pluginId);
+    if (!matches.isEmpty()) {
+        const QFileInfo directory(cached->packages.path(matches.constFirst()));
+        // Package::setPath looks for a directory named like the plugin id
+        if (directory.fileName() == pluginId) {
+            path = directory.canonicalFilePath();
+        }
+    }
+    cached->cacheCanonicalPath(pluginId, path);
+    return path;
+}
 
-            const QString metadataPath = it.fileInfo().absoluteFilePath();
-            KPluginMetaData info = KPluginMetaData::fromJsonFile(metadataPath);
+void PackageLoaderPrivate::CachedListing::buildIndex()
+{
+    pluginIds.clear();
+    categories.clear();
+    for (qsizetype i = 0; i < packages.size(); ++i) {
+        pluginIds[packages.pluginId(i)] << i;
+        categories[packages.category(i)] << i;
+    }
+}
 
-            if (!info.isValid() || uniqueIds.contains(info.pluginId())) {
-                continue;
-            }
+std::optional<QString> PackageLoaderPrivate::CachedListing::canonicalPath(const QString &pluginId) const
+{
+    QMutexLocker locker(&lookups->mutex);
+    if (auto it = lookups->canonicalPaths.constFind(pluginId); it != lookups->canonicalPaths.constEnd()) {
+        return it.value();
+    }
+    return std::nullopt;
+}
+
+void PackageLoaderPrivate::CachedListing::cacheCanonicalPath(const QString &pluginId, const QString &path) const
+{
+    QMutexLocker locker(&lookups->mutex);
+    lookups->canonicalPaths.insert(pluginId, path);
+}
+
+QList<KPluginMetaData> PackageLoaderPrivate::CachedListing::toList() const
+{
+    QMutexLocker locker(&lookups->mutex);
+    if (lookups->metadata) {
+        return *lookups->metadata;
+    }
+    // decoded without holding the lock, the lookups of other threads don't have to wait for it
+    locker.unlock();
+    const QList<KPluginMetaData> metadata = packages.toList();
+    locker.relock();
+    if (!lookups->metadata) {
+        lookups->metadata = metadata;
+    }
+    return *lookups->metadata;
+}
 
-            if (packageFormat.isEmpty() || readKPackageType(info) == packageFormat) {
-                uniqueIds << info.pluginId();
-                lst << info;
-            } else {
-                qInfo() << "KPackageStructure of" << info << "does not match requested format" << packageFormat;
+QList<KPluginMetaData> PackageLoaderPrivate::CachedListing::query(const PackageQuery &query) const
+{
+    // the candidates come from the most selective criterion, the others are then checked on them only
+    std::optional<QList<qsizetype>> candidates;
+    auto narrow = [&candidates](const QList<qsizetype> &matches) {
+        if (!candidates || matches.size() < candidates->size()) {
+            candidates = matches;
+        }
+    };
+
+    const QString pluginId = query.pluginId();
+    if (!pluginId.isEmpty()) {
+        narrow(pluginIds.value(pluginId));
+    }
+
+    const QStringList wantedCategories = query.categories();
+    if (!wantedCategories.isEmpty()) {
+        QList<qsizetype> matches;
+        for (const QString &category : wantedCategories) {
+            matches += categories.value(category);
+        }
+        // keep the listing order when several categories match
+        std::sort(matches.begin(), matches.end());
+        matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+        narrow(matches);
+    }
+
+    const QHash<QString, QString> values = query.values();
+    for (auto it = values.cbegin(); it != values.cend(); ++it) {
+        QMutexLocker locker(&lookups->mutex);
+        auto valuesIt = lookups->values.constFind(it.key());
+        if (valuesIt == lookups->values.constEnd()) {
+            // don't hold up the other threads while going through all the packages, the index of one of them
+            // which got there first is kept
+            locker.unlock();
+            QHash<QString, QList<qsizetype>> index;
+            for (qsizetype i = 0; i < packages.size(); ++i) {
+                index[packages.metadata(i).value(it.key())] << i;
+            }
+            locker.relock();
+            valuesIt = lookups->values.constFind(it.key());
+            if (valuesIt == lookups->values.constEnd()) {
+                valuesIt = lookups->values.insert(it.key(), index);
             }
         }
+        narrow(valuesIt->value(it.value()));
     }
 
-    if (useRuntimeCache) {
-        d->pluginCache.insert(cacheKey, lst);
+    if (!candidates) {
+        return toList();
+    }
+
+    // only the candidates get decoded
+    QList<KPluginMetaData> lst;
+    for (qsizetype i : std::as_const(*candidates)) {
+        if (!pluginId.isEmpty() && packages.pluginId(i) != pluginId) {
+            continue;
+        }
+        if (!wantedCategories.isEmpty() && !wantedCategories.contains(packages.category(i))) {
+            continue;
+        }
+        const KPluginMetaData metadata = packages.metadata(i);
+        bool valuesMatch = true;
+        for (auto it = values.cbegin(); valuesMatch && it != values.cend(); ++it) {
+            valuesMatch = metadata.value(it.key()) == it.value();
+        }
+        if (valuesMatch) {
+            lst << metadata;
+        }
     }
     return lst;
 }
 
+QList<KPluginMetaData> PackageLoader::listPackages(const QString &packageFormat, const QString &packageRoot)
+{
+    return d->listing(this, packageFormat, packageRoot)->toList();
+}
+
+QHash<QString, QList<KPluginMetaData>> PackageLoader::listPackagesByFormat(const QStringList &packageFormats, const QString &packageRoot)
+{
+    QHash<QString, QList<KPluginMetaData>> result;
+    // the formats which aren't in the cache yet, along with all the roots they need
+    QList<PackageLoaderPrivate::CachedListing> pending;
+    QStringList roots;
+    for (const QString &packageFormat : packageFormats) {
+        if (result.contains(packageFormat)) {
+            continue;
+        }
+        if (auto cached = d->upToDateListing(PackageLoaderPrivate::cacheKey(packageFormat, packageRoot))) {
+            result.insert(packageFormat, cached->toList());
+            continue;
+        }
+        // known to be pending, an empty list stands in for it meanwhile
+        result.insert(packageFormat, {});
+        pending << PackageLoaderPrivate::prepareListing(this, packageFormat, packageRoot);
+        for (const QString &root : std::as_const(pending.constLast().roots)) {
+            if (!roots.contains(root)) {
+                roots << root;
+            }
+        }
+    }
+    if (pending.isEmpty()) {
+        return result;
+    }
+    d->setupNotifications();
+
+    // roots shared by several formats, like the ones of formats without a dedicated root, get read once
+    const QHash<QString, MetadataTable> entriesPerRoot = PackageLoaderPrivate::readRoots(roots);
+    for (PackageLoaderPrivate::CachedListing &listing : pending) {
+        const QString packageFormat = listing.packageFormat;
+        PackageLoaderPrivate::mergeRoots(listing, entriesPerRoot);
+        const auto published = d->publishListing(PackageLoaderPrivate::cacheKey(packageFormat, packageRoot), std::move(listing));
+        result.insert(packageFormat, published->toList());
+    }
+    return result;
+}
+
+QList<KPluginMetaData> PackageLoader::queryPackages(const QString &packageFormat, const PackageQuery &query, const QString &packageRoot)
+{
+    return d->listing(this, packageFormat, packageRoot)->query(query);
+}
+
+PackageListJob *PackageLoader::listPackagesAsync(const QString &packageFormat, const QString &packageRoot, std::function<bool(const KPluginMetaData &)> filter)
+{
+    auto job = new PackageListJob(packageFormat, packageRoot, filter);
+    job->start();
+    return job;
+}
+
+PackagePrefetchJob *PackageLoader::prefetchPackages(const QList<Package> &packages, const QList<QByteArray> &fileTypes)
+{
+    auto job = new PackagePrefetchJob(packages, fileTypes);
+    job->start();
+    return job;
+}
+
 QList<KPluginMetaData> PackageLoader::listPackagesMetadata(const QString &packageFormat, const QString &packageRoot)
 {
     return listPackages(packageFormat, packageRoot);
@@ -244,20 +642,14 @@ PackageLoader::findPackages(const QString &packageFormat, const QString &package
 
 KPackage::PackageStructure *PackageLoader::loadPackageStructure(const QString &packageFormat)
 {
-    PackageStructure *structure = d->structures.value(packageFormat).data();
-    if (!structure) {
-        if (packageFormat == QLatin1String("KPackage/Generic")) {
-            structure = new GenericPackage();
-            d->structures.insert(packageFormat, structure);
-        } else if (packageFormat == QLatin1String("KPackage/GenericQML")) {
-            structure = new GenericQMLPackage();
-            d->structures.insert(packageFormat, structure);
-        }
-    }
-
-    if (structure) {
+    if (PackageStructure *structure = d->state.load()->structures.value(packageFormat).data()) {
         return structure;
     }
+    if (packageFormat == QLatin1String("KPackage/Generic")) {
+        return d->publishStructure(packageFormat, new GenericPackage());
+    } else if (packageFormat == QLatin1String("KPackage/GenericQML")) {
+        return d->publishStructure(packageFormat, new GenericQMLPackage());
+    }
 
     const KPluginMetaData metaData = structureForKPackageType(packageFormat);
     if (!metaData.isValid()) {
@@ -271,21 +663,51 @@ KPackage::PackageStructure *PackageLoader::loadPackageStructure(const QString &p
         return nullptr;
     }
 
-    structure = result.plugin;
+    return d->publishStructure(packageFormat, result.plugin);
+}
+
+void PackageLoader::addKnownPackageStructure(const QString &packageFormat, KPackage::PackageStructure *structure)
+{
+    d->publishStructure(packageFormat, structure, true);
+}
 
-    d->structures.insert(packageFormat, structure);
+bool PackageLoader::generateSharedIndex(const QString &packageRoot)
+{
+    return PackageIndex::generateSharedIndex(packageRoot);
+}
 
-    return structure;
+bool PackageLoader::removeSharedIndex(const QString &packageRoot)
+{
+    return PackageIndex::removeSharedIndex(packageRoot);
 }
 
-void PackageLoader::addKnownPackageStructure(const QString &packageFormat, KPackage::PackageStructure *structure)
+void PackageLoader::dumpInstrumentation()
 {
-    d->structures.insert(packageFormat, structure);
+    if (Instrumentation::isEnabled()) {
+        Instrumentation::dump();
+    }
 }
 
-void PackageLoader::invalidateCache()
+void PackageLoader::invalidateCache(const QString &packageFormat, const QString &packageRoot)
 {
-    self()->d->maxCacheAge = -1;
+    PackageLoaderPrivate *d = self()->d;
+    if (packageFormat.isEmpty() && packageRoot.isEmpty()) {
+        d->state.update([](PackageLoaderPrivate::State &snapshot) {
+            snapshot.pluginCache.clear();
+            return true;
+        });
+        return;
+    }
+    if (!packageFormat.isEmpty()) {
+        d->invalidateFormat(packageFormat);
+    }
+    if (!packageRoot.isEmpty()) {
+        d->invalidateRoot(packageRoot);
+    }
 }
 
 } // KPackage Namespace
+
+#if HAVE_QTDBUS
+#include "packageloader.moc"
+#endif
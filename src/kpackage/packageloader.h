@@ -8,12 +8,17 @@
 #define KPACKAGE_LOADER_H
 
 #include <kpackage/package.h>
+#include <kpackage/packagequery.h>
+
+#include <QHash>
 
 #include <kpackage/package_export.h>
 
 namespace KPackage
 {
+class PackageListJob;
 class PackageLoaderPrivate;
+class PackagePrefetchJob;
 
 /**
  * @class PackageLoader kpackage/packageloader.h <KPackage/PackageLoader>
@@ -25,6 +30,9 @@ class PackageLoaderPrivate;
  * not do more than simply returning a loaded plugin. It should not init() it, and it should not
  * hang on to it.
  *
+ * Since 6.13 the loader may be used from several threads at once. Listings and lookups
+ * read a consistent snapshot of what the loader knows without taking a lock.
+ *
  * @author Ryan Rix <ry@n.rix.si>
  **/
 class KPACKAGE_EXPORT PackageLoader
@@ -53,12 +61,61 @@ public:
      */
     QList<KPluginMetaData> listPackages(const QString &packageFormat, const QString &packageRoot = QString());
 
+    /**
+     * List all available packages of a certain type without blocking the calling thread.
+     *
+     * The roots are read on the global thread pool, the packages found are reported in batches
+     * through PackageListJob::packagesFound as soon as they are known, in the order listPackages
+     * would return them. The listing ends up in the same cache as the one of listPackages,
+     * if it is already cached the job reports all of it at once.
+     *
+     * @param packageFormat the format of the packages to list
+     * @param packageRoot the root folder where the packages are installed.
+     *          If not specified the default from the packageformat will be taken.
+     * @param filter an optional filter function, only the packages it returns true for are reported.
+     *          It is called on the thread of the job, not on the thread pool.
+     *
+     * @return the job listing the packages, it is already started
+     * @since 6.13
+     */
+    PackageListJob *listPackagesAsync(const QString &packageFormat,
+                                      const QString &packageRoot = QString(),
+                                      std::function<bool(const KPluginMetaData &)> filter = std::function<bool(const KPluginMetaData &)>());
+
+    /**
+     * Looks up the required files of all the @p packages and their files of @p fileTypes without blocking
+     * the calling thread, and asks the system to read them ahead, like Package::prefetch does for a single package.
+     * The packages are looked into in parallel on the global thread pool, so that for instance all the
+     * packages of a layout can be warmed up before any of them gets loaded.
+     *
+     * @param packages the packages to look up the files of
+     * @param fileTypes the files to look up besides the required ones, e.g. "mainscript"
+     * @return the job looking up the files, it is already started
+     * @since 6.13
+     */
+    PackagePrefetchJob *prefetchPackages(const QList<Package> &packages, const QList<QByteArray> &fileTypes = {});
+
     /**
      * @overload
      * @since 6.0
      */
     QList<KPluginMetaData> listPackagesMetadata(const QString &packageFormat, const QString &packageRoot = QString());
 
+    /**
+     * List all available packages of several types at once, like listPackages for each of them.
+     *
+     * Each package root is read once, however many of the formats look into it, and all the roots are read in parallel.
+     * The listings are cached as well, a listPackages for one of the formats is then answered without reading anything.
+     *
+     * @param packageFormats the formats of the packages to list
+     * @param packageRoot the root folder where the packages are installed.
+     *          If not specified the default of each packageformat will be taken.
+     * @return the metadata of the packages of each of the formats, formats without any package included
+     *
+     * @since 6.13
+     */
+    QHash<QString, QList<KPluginMetaData>> listPackagesByFormat(const QStringList &packageFormats, const QString &packageRoot = QString());
+
     /**
      * List all available packages of a certain type. This should be used in case the package structure modifies the metadata or you need to access the
      * contained files of the package.
@@ -71,6 +128,22 @@ public:
      */
     QList<Package> listKPackages(const QString &packageFormat, const QString &packageRoot = QString());
 
+    /**
+     * List all available packages of a certain type, like listKPackages, without touching the packages themselves.
+     *
+     * The returned packages only carry the metadata gathered by listPackages. Their structure is set up and their
+     * path resolved the first time anything but metadata() is asked from them, so listing is almost free for
+     * callers which only need to show the packages. As their validity isn't checked up front, some of them may
+     * turn out to be invalid once accessed, packages without metadata file aren't listed at all.
+     *
+     * @param packageFormat the format of the packages to list
+     * @param packageRoot the root folder where the packages are installed.
+     *          If not specified the default from the packageformat will be taken.
+     *
+     * @since 6.13
+     */
+    QList<Package> listKPackagesLazily(const QString &packageFormat, const QString &packageRoot = QString());
+
     /**
      * List package of a certain type that match a certain filter function
      *
@@ -87,6 +160,23 @@ public:
                                         const QString &packageRoot = QString(),
                                         std::function<bool(const KPluginMetaData &)> filter = std::function<bool(const KPluginMetaData &)>());
 
+    /**
+     * List the packages of a certain type matching @p query.
+     *
+     * The lookups are answered from hash indices of the cached listing of listPackages, so that
+     * looking up packages by plugin id, category or metadata value doesn't cost a call for
+     * every package installed.
+     *
+     * @param packageFormat the format of the packages to list
+     * @param query the criteria the packages have to match
+     * @param packageRoot the root folder where the packages are installed.
+     *          If not specified the default from the packageformat will be taken.
+     *
+     * @return metadata for all the matching packages, in the order of listPackages
+     * @since 6.13
+     */
+    QList<KPluginMetaData> queryPackages(const QString &packageFormat, const PackageQuery &query, const QString &packageRoot = QString());
+
     /**
      * Loads a PackageStructure for a given format. The structure can then be used as
      * paramenter for a Package instance constructor
@@ -112,14 +202,49 @@ public:
      **/
     static PackageLoader *self();
 
+    /**
+     * Writes an index of the packages installed in @p packageRoot, shared by all the processes of all the users.
+     * Meant for the system-wide package roots: listing them then takes a read of the index instead of a scan of
+     * the root in every process. The root has to be inside one of the system-wide data directories, not the one of
+     * the user, the index gets written into the "kpackage/index" directory of that data directory. Packages installed in the root with PackageJob keep
+     * the index up to date, the index is ignored as soon as the root changes behind its back.
+     *
+     * @param packageRoot absolute path of the package root, such as "/usr/share/plasma/plasmoids"
+     * @return whether the index could be written
+     * @see kpackagetool6 --generate-index
+     * @since 6.13
+     */
+    static bool generateSharedIndex(const QString &packageRoot);
+
+    /**
+     * Removes the index written by generateSharedIndex for @p packageRoot.
+     *
+     * @return whether there was an index to remove
+     * @since 6.13
+     */
+    static bool removeSharedIndex(const QString &packageRoot);
+
+    /**
+     * Prints how much time the lookups of packages took so far and how often the caches could answer them,
+     * as the application already does when it exits. Useful for long running processes, e.g. after startup.
+     *
+     * Does nothing unless the instrumentation is enabled, by setting KPACKAGE_INSTRUMENTATION=1 in the
+     * environment or by enabling the info messages of the kf.package.instrumentation logging category.
+     *
+     * @since 6.13
+     */
+    static void dumpInstrumentation();
+
 protected:
     PackageLoader();
     virtual ~PackageLoader();
 
 private:
     friend class Package;
+    friend class PackageBatchJob;
     friend class PackageJob;
-    KPACKAGE_NO_EXPORT static void invalidateCache();
+    friend class PackageListJob;
+    KPACKAGE_NO_EXPORT static void invalidateCache(const QString &packageFormat = QString(), const QString &packageRoot = QString());
 
     PackageLoaderPrivate *const d;
     Q_DISABLE_COPY(PackageLoader)
@@ -0,0 +1,93 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "packageprefetchjob.h"
+
+#include "private/package_p.h"
+#include "private/packageprefetchjobthread_p.h"
+
+#include "kpackage_debug.h"
+
+#include <QThreadPool>
+#include <QTimer>
+
+namespace KPackage
+{
+class PackagePrefetchJobPrivate
+{
+public:
+    QList<Package> packages;
+    // copies of the packages the thread works on, the packages themselves stay on the thread of the job
+    std::shared_ptr<QList<Package>> copies = std::make_shared<QList<Package>>();
+    PackagePrefetchJobThread *thread = nullptr;
+    std::shared_ptr<std::atomic_bool> canceled = std::make_shared<std::atomic_bool>(false);
+    bool started = false;
+};
+
+PackagePrefetchJob::PackagePrefetchJob(const QList<Package> &packages, const QList<QByteArray> &fileTypes)
+    : KJob()
+    , d(new PackagePrefetchJobPrivate)
+{
+    d->packages = packages;
+    d->copies->reserve(packages.size());
+    for (const Package &package : packages) {
+        *d->copies << PackagePrivate::detachedCopy(package);
+    }
+
+    d->thread = new PackagePrefetchJobThread(d->copies, fileTypes, d->canceled);
+    connect(
+        d->thread,
+        &PackagePrefetchJobThread::prefetchFinished,
+        this,
+        [this]() {
+            for (qsizetype i = 0; i < d->packages.size(); ++i) {
+                PackagePrivate::takeDiscoveries(d->packages.at(i), d->copies->at(i));
+            }
+            d->copies->clear();
+            emitResult();
+        },
+        Qt::QueuedConnection);
+}
+
+PackagePrefetchJob::~PackagePrefetchJob()
+{
+    *d->canceled = true;
+    // once started the thread pool owns it
+    if (!d->started) {
+        delete d->thread;
+    }
+}
+
+void PackagePrefetchJob::start()
+{
+    if (d->started) {
+        qCWarning(KPACKAGE_LOG) << "The KPackage::PackagePrefetchJob was already started";
+        return;
+    }
+    d->started = true;
+
+    if (d->packages.isEmpty()) {
+        // the caller needs a chance to connect to the signals first
+        QTimer::singleShot(0, this, &PackagePrefetchJob::emitResult);
+    } else {
+        QThreadPool::globalInstance()->start(d->thread);
+    }
+}
+
+QList<Package> PackagePrefetchJob::packages() const
+{
+    return d->packages;
+}
+
+bool PackagePrefetchJob::doKill()
+{
+    *d->canceled = true;
+    return true;
+}
+
+} // namespace KPackage
+
+#include "moc_packageprefetchjob.cpp"
@@ -0,0 +1,64 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPACKAGE_PACKAGEPREFETCHJOB_H
+#define KPACKAGE_PACKAGEPREFETCHJOB_H
+
+#include <kpackage/package.h>
+#include <kpackage/package_export.h>
+
+#include <KJob>
+
+#include <memory>
+
+namespace KPackage
+{
+class PackagePrefetchJobPrivate;
+class PackageLoader;
+
+/**
+ * @class PackagePrefetchJob kpackage/packageprefetchjob.h <KPackage/PackagePrefetchJob>
+ * @short KJob subclass looking up the files of packages ahead of their use
+ *
+ * The jobs are created by Package::prefetch and PackageLoader::prefetchPackages.
+ * The files are looked up on the global thread pool and the system is asked to read them ahead.
+ * Once the job is finished, Package::filePath answers for them without touching the disk.
+ *
+ * @code
+ * auto job = KPackage::PackageLoader::self()->prefetchPackages(applets, {"mainscript"});
+ * connect(job, &KJob::result, this, &Layout::loadApplets);
+ * @endcode
+ *
+ * @since 6.13
+ */
+class KPACKAGE_EXPORT PackagePrefetchJob : public KJob
+{
+    Q_OBJECT
+
+public:
+    ~PackagePrefetchJob() override;
+
+    /**
+     * @return the packages the job looks up files for
+     */
+    QList<Package> packages() const;
+
+protected:
+    bool doKill() override;
+
+private:
+    friend class Package;
+    friend class PackageLoader;
+    void start() override;
+
+    KPACKAGE_NO_EXPORT explicit PackagePrefetchJob(const QList<Package> &packages, const QList<QByteArray> &fileTypes);
+
+    const std::unique_ptr<PackagePrefetchJobPrivate> d;
+};
+
+}
+
+#endif
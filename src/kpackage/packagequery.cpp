@@ -0,0 +1,63 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "packagequery.h"
+
+namespace KPackage
+{
+class PackageQueryPrivate : public QSharedData
+{
+public:
+    QString pluginId;
+    QHash<QString, QString> values;
+    QStringList categories;
+};
+
+PackageQuery::PackageQuery()
+    : d(new PackageQueryPrivate)
+{
+}
+
+PackageQuery::PackageQuery(const PackageQuery &other) = default;
+
+PackageQuery::~PackageQuery() = default;
+
+PackageQuery &PackageQuery::operator=(const PackageQuery &other) = default;
+
+PackageQuery &PackageQuery::setPluginId(const QString &pluginId)
+{
+    d->pluginId = pluginId;
+    return *this;
+}
+
+QString PackageQuery::pluginId() const
+{
+    return d->pluginId;
+}
+
+PackageQuery &PackageQuery::addValue(const QString &key, const QString &value)
+{
+    d->values.insert(key, value);
+    return *this;
+}
+
+QHash<QString, QString> PackageQuery::values() const
+{
+    return d->values;
+}
+
+PackageQuery &PackageQuery::setCategories(const QStringList &categories)
+{
+    d->categories = categories;
+    return *this;
+}
+
+QStringList PackageQuery::categories() const
+{
+    return d->categories;
+}
+
+}
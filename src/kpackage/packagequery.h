@@ -0,0 +1,70 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPACKAGE_PACKAGEQUERY_H
+#define KPACKAGE_PACKAGEQUERY_H
+
+#include <kpackage/package_export.h>
+
+#include <QHash>
+#include <QSharedDataPointer>
+#include <QStringList>
+
+namespace KPackage
+{
+class PackageQueryPrivate;
+
+/**
+ * @class PackageQuery kpackage/packagequery.h <KPackage/PackageQuery>
+ * @short Declarative description of the packages to look up with PackageLoader::queryPackages
+ *
+ * A package matches when it fulfills all the criteria which were set, a query without criteria
+ * matches all the packages.
+ *
+ * @code
+ * const auto applets = KPackage::PackageLoader::self()->queryPackages(QStringLiteral("Plasma/Applet"),
+ *     KPackage::PackageQuery().addValue(QStringLiteral("X-Plasma-NotificationArea"), QStringLiteral("true")));
+ * @endcode
+ *
+ * Unlike the filter function of PackageLoader::findPackages the criteria are answered from indices
+ * of the cached listing, which are built once per listing.
+ *
+ * @since 6.13
+ */
+class KPACKAGE_EXPORT PackageQuery
+{
+public:
+    PackageQuery();
+    PackageQuery(const PackageQuery &other);
+    ~PackageQuery();
+    PackageQuery &operator=(const PackageQuery &other);
+
+    /**
+     * Only matches the package with the given plugin id
+     */
+    PackageQuery &setPluginId(const QString &pluginId);
+    QString pluginId() const;
+
+    /**
+     * Only matches the packages whose metadata has @p value for the top level @p key,
+     * as returned by KPluginMetaData::value
+     */
+    PackageQuery &addValue(const QString &key, const QString &value);
+    QHash<QString, QString> values() const;
+
+    /**
+     * Only matches the packages belonging to one of the given categories, see KPluginMetaData::category
+     */
+    PackageQuery &setCategories(const QStringList &categories);
+    QStringList categories() const;
+
+private:
+    QSharedDataPointer<PackageQueryPrivate> d;
+};
+
+}
+
+#endif
@@ -8,17 +8,69 @@
 #include "kpackage_debug.h"
 #include "packagejob.h"
 #include "private/package_p.h"
+#include "private/packagestructure_p.h"
 
 namespace KPackage
 {
+QExplicitlySharedDataPointer<PackagePrivate> PackageStructurePrivate::packageTemplate(PackageStructure *structure)
+{
+    quint64 templateGeneration;
+    {
+        QMutexLocker locker(&mutex);
+        if (!templateEnabled) {
+            return {};
+        }
+        if (m_packageTemplate) {
+            return m_packageTemplate;
+        }
+        templateGeneration = generation;
+    }
+
+    // built outside of the lock, initPackage is free to do whatever it wants
+    const QExplicitlySharedDataPointer<PackagePrivate> packageTemplate = PackagePrivate::initializedBy(structure);
+
+    QMutexLocker locker(&mutex);
+    if (!m_packageTemplate && generation == templateGeneration) {
+        m_packageTemplate = packageTemplate;
+    }
+    // an outdated template still is what initPackage returned when we asked
+    return m_packageTemplate ? m_packageTemplate : packageTemplate;
+}
+
+void PackageStructurePrivate::setPackageTemplateEnabled(bool enabled)
+{
+    QMutexLocker locker(&mutex);
+    templateEnabled = enabled;
+    m_packageTemplate.reset();
+    ++generation;
+}
+
+void PackageStructurePrivate::invalidatePackageTemplate()
+{
+    QMutexLocker locker(&mutex);
+    m_packageTemplate.reset();
+    ++generation;
+}
+
 PackageStructure::PackageStructure(QObject *parent, const QVariantList & /*args*/)
     : QObject(parent)
+    , d(new PackageStructurePrivate)
 {
-    Q_UNUSED(d)
 }
 
 PackageStructure::~PackageStructure()
 {
+    delete PackageStructurePrivate::get(this);
+}
+
+void PackageStructure::setPackageTemplateEnabled(bool enabled)
+{
+    PackageStructurePrivate::get(this)->setPackageTemplateEnabled(enabled);
+}
+
+void PackageStructure::invalidatePackageTemplate()
+{
+    PackageStructurePrivate::get(this)->invalidatePackageTemplate();
 }
 
 void PackageStructure::initPackage(Package * /*package*/)
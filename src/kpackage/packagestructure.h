@@ -53,6 +53,10 @@ public:
      *
      * @param package the Package to set up. The object is empty of all definition when
      *      first passed in.
+     *
+     * @note Structures which enable their package template with setPackageTemplateEnabled get
+     *      this called only once, on a package of their own rather than on each new package:
+     *      the definitions it sets up are then copied into every package created with the structure.
      */
     virtual void initPackage(Package *package);
 
@@ -62,7 +66,36 @@ public:
      */
     virtual void pathChanged(Package *package);
 
+protected:
+    /**
+     * Lets the packages of this structure start from a template instead of running initPackage for each
+     * of them. initPackage is then called once, on a package none of the callers gets to see, and every Package
+     * created with the structure gets a copy of the definitions it set up. Copying them is much cheaper than
+     * setting them up again, which matters for structures with many packages.
+     *
+     * Only meant for structures whose initPackage sets up every package the same way, e.g. one which doesn't
+     * keep the package it is passed or look at anything but the structure itself. The template is disabled
+     * by default, initPackage then gets called for every new package as before 6.13.
+     *
+     * Usually called from the constructor of the structure.
+     *
+     * @see invalidatePackageTemplate
+     * @since 6.13
+     */
+    void setPackageTemplateEnabled(bool enabled);
+
+    /**
+     * Drops the template of the packages of this structure, the next package created runs initPackage again.
+     * Structures with an enabled template whose initPackage depends on some of their state have to call this
+     * whenever that state changes.
+     *
+     * @see setPackageTemplateEnabled
+     * @since 6.13
+     */
+    void invalidatePackageTemplate();
+
 private:
+    friend class PackageStructurePrivate;
     void *d;
 };
 
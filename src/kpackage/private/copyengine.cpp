@@ -0,0 +1,165 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "private/copyengine_p.h"
+#include "private/parallel_p.h"
+
+#include "config-package.h"
+#include "kpackage_debug.h"
+
+#include <QDir>
+#include <QFile>
+
+#include <atomic>
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace KPackage
+{
+namespace CopyEngine
+{
+#ifdef Q_OS_LINUX
+// @return whether the data could be copied without going through user space
+static bool copyData(int source, int target, off_t size)
+{
+#ifdef FICLONE
+    if (::ioctl(target, FICLONE, source) == 0) {
+        return true;
+    }
+#endif
+#if HAVE_COPY_FILE_RANGE
+    off_t remaining = size;
+    while (remaining > 0) {
+        const ssize_t copied = ::copy_file_range(source, nullptr, target, nullptr, remaining, 0);
+        if (copied <= 0) {
+            break;
+        }
+        remaining -= copied;
+    }
+    return remaining == 0;
+#else
+    // the C library has no wrapper for it, QFile::copy takes over
+    return size == 0;
+#endif
+}
+#endif
+
+static bool copyFile(const QString &sourcePath, const QString &targetPath)
+{
+#ifdef Q_OS_LINUX
+    const int source = ::open(QFile::encodeName(sourcePath).constData(), O_RDONLY | O_CLOEXEC);
+    if (source < 0) {
+        return false;
+    }
+    struct stat sourceStat;
+    if (::fstat(source, &sourceStat) != 0) {
+        ::close(source);
+        return false;
+    }
+    const int target = ::open(QFile::encodeName(targetPath).constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, sourceStat.st_mode & 07777);
+    if (target < 0) {
+        ::close(source);
+        return false;
+    }
+    const bool copied = copyData(source, target, sourceStat.st_size);
+    ::close(target);
+    ::close(source);
+    if (copied) {
+        return true;
+    }
+    // e.g. a filesystem without copy_file_range support, QFile::copy wants to create the file itself
+    QFile::remove(targetPath);
+#endif
+    return QFile::copy(sourcePath, targetPath);
+}
+
+bool copyTree(const QString &sourcePath, const QString &targetPath)
+{
+    if (!QDir(sourcePath).exists()) {
+        return false;
+    }
+
+    // gather the whole tree first so the directories get created in one go, parents first,
+    // and the files can be copied in parallel
+    QStringList directories{QString()};
+    QStringList files;
+    for (qsizetype i = 0; i < directories.size(); ++i) {
+        const QString relativePath = directories.at(i);
+        const QDir source(relativePath.isEmpty() ? sourcePath : sourcePath + QLatin1Char('/') + relativePath);
+        const QString prefix = relativePath.isEmpty() ? QString() : relativePath + QLatin1Char('/');
+        const QStringList fileNames = source.entryList(QDir::Files);
+        for (const QString &fileName : fileNames) {
+            files << prefix + fileName;
+        }
+        const QStringList subdirectoryNames = source.entryList(QDir::AllDirs | QDir::NoDotAndDotDot);
+        for (const QString &subdirectoryName : subdirectoryNames) {
+            directories << prefix + subdirectoryName;
+        }
+    }
+
+    QDir target;
+    for (const QString &relativePath : std::as_const(directories)) {
+        const QString directory = relativePath.isEmpty() ? targetPath : targetPath + QLatin1Char('/') + relativePath;
+        if (!target.exists(directory) && !target.mkdir(directory)) {
+            qCWarning(KPACKAGE_LOG) << "Could not create directory" << directory;
+            return false;
+        }
+    }
+
+    std::atomic_bool ok = true;
+    parallelFor(files.size(), [&](qsizetype i) {
+        if (ok && !copyFile(sourcePath + QLatin1Char('/') + files.at(i), targetPath + QLatin1Char('/') + files.at(i))) {
+            ok = false;
+        }
+    });
+    return ok;
+}
+
+bool moveTree(const QString &sourcePath, const QString &targetPath)
+{
+    if (QDir().rename(QDir::cleanPath(sourcePath), QDir::cleanPath(targetPath))) {
+        return true;
+    }
+    return copyTree(sourcePath, targetPath) && QDir(sourcePath).removeRecursively();
+}
+
+bool exchangeTrees(const QString &first, const QString &second)
+{
+    const QString firstPath = QDir::cleanPath(first);
+    const QString secondPath = QDir::cleanPath(second);
+#if HAVE_RENAMEAT2 && defined(RENAME_EXCHANGE)
+    if (::renameat2(AT_FDCWD, QFile::encodeName(firstPath).constData(), AT_FDCWD, QFile::encodeName(secondPath).constData(), RENAME_EXCHANGE) == 0) {
+        return true;
+    }
+    if (errno != ENOSYS && errno != EINVAL) {
+        qCWarning(KPACKAGE_LOG) << "Could not exchange" << firstPath << "and" << secondPath << ::strerror(errno);
+        return false;
+    }
+#endif
+    // second is missing for the time of the renames, next to first so it stays hidden if first is
+    const QString aside = firstPath + QLatin1String(".exchange");
+    QDir dir;
+    if (!dir.rename(secondPath, aside)) {
+        return false;
+    }
+    if (!dir.rename(firstPath, secondPath)) {
+        dir.rename(aside, secondPath);
+        return false;
+    }
+    return dir.rename(aside, firstPath);
+}
+
+}
+}
@@ -0,0 +1,34 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPACKAGE_COPYENGINE_P_H
+#define KPACKAGE_COPYENGINE_P_H
+
+#include <QString>
+
+namespace KPackage
+{
+/**
+ * Copies and moves package directories for PackageJob.
+ *
+ * Like QFile::copy, files are copied with their permissions and symlinks are followed; hidden files
+ * are left out. On Linux the data is shared with a reflink where the filesystem supports it
+ * and copied in the kernel with copy_file_range otherwise.
+ */
+namespace CopyEngine
+{
+// copies the contents of @p sourcePath into @p targetPath, which gets created if needed
+bool copyTree(const QString &sourcePath, const QString &targetPath);
+// moves @p sourcePath to @p targetPath with a rename, copies it over if they aren't on the same filesystem
+bool moveTree(const QString &sourcePath, const QString &targetPath);
+// swaps the directories @p first and @p second, which have to be on the same filesystem.
+// This is atomic where the system supports exchanging paths, renameat2 on Linux
+bool exchangeTrees(const QString &first, const QString &second);
+}
+
+}
+
+#endif
@@ -0,0 +1,165 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "private/dependencyresolver_p.h"
+
+#include "config-package.h"
+#include "kpackage_debug.h"
+
+#include <QDeadlineTimer>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QUrl>
+
+#include <algorithm>
+#include <memory>
+
+namespace KPackage
+{
+static QString resolveHandler(const QString &scheme)
+{
+    static QMutex mutex;
+    // keyed by the search path too, it may be changed by the environment variable
+    static QHash<QString, QString> handlers;
+
+    QString envOverride = qEnvironmentVariable("KPACKAGE_DEP_RESOLVERS_PATH");
+    const QString key = envOverride + QLatin1Char('\n') + scheme;
+    QMutexLocker locker(&mutex);
+    if (auto it = handlers.constFind(key); it != handlers.cend()) {
+        return it.value();
+    }
+
+    QStringList searchDirs;
+    if (!envOverride.isEmpty()) {
+        searchDirs.push_back(envOverride);
+    }
+    searchDirs.append(QStringLiteral(KDE_INSTALL_FULL_LIBEXECDIR_KF "/kpackagehandlers"));
+    // We have to use QStandardPaths::findExecutable here to handle the .exe suffix on Windows.
+    const QString handler = QStandardPaths::findExecutable(scheme + QLatin1String("handler"), searchDirs);
+    handlers.insert(key, handler);
+    return handler;
+}
+
+static int environmentValue(const char *name, int defaultValue)
+{
+    bool ok = false;
+    const int value = qEnvironmentVariableIntValue(name, &ok);
+    return ok && value > 0 ? value : defaultValue;
+}
+
+void DependencyResolver::setState(const QString &dependency, State state)
+{
+    QMutexLocker locker(&m_mutex);
+    m_states.insert(dependency, state);
+    m_stateChanged.wakeAll();
+}
+
+bool DependencyResolver::resolve(const QStringList &dependencies, QString *failedDependency)
+{
+    // the ones to install ourselves, and the ones another job of the batch is installing right now
+    QStringList toInstall;
+    QStringList toWaitFor;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (const QString &dependency : dependencies) {
+            if (toInstall.contains(dependency) || toWaitFor.contains(dependency)) {
+                continue;
+            }
+            const auto it = m_states.constFind(dependency);
+            if (it == m_states.cend()) {
+                m_states.insert(dependency, Resolving);
+                toInstall << dependency;
+            } else if (it.value() == Resolving) {
+                toWaitFor << dependency;
+            } else if (it.value() == Failed) {
+                *failedDependency = dependency;
+                // give back what we claimed, someone else may try them
+                for (const QString &claimed : std::as_const(toInstall)) {
+                    m_states.remove(claimed);
+                }
+                m_stateChanged.wakeAll();
+                return false;
+            }
+        }
+    }
+
+    const int maximumRunning = environmentValue("KPACKAGE_DEP_RESOLVERS_MAX_JOBS", 4);
+    // handlers like the KNewStuff one may wait for the user for as long as it takes, no timeout unless asked for
+    const int timeoutSeconds = environmentValue("KPACKAGE_DEP_RESOLVERS_TIMEOUT", -1);
+    const qint64 timeout = timeoutSeconds > 0 ? qint64(timeoutSeconds) * 1000 : -1;
+
+    struct Running {
+        QString dependency;
+        std::unique_ptr<QProcess> process;
+        QDeadlineTimer deadline;
+    };
+    std::vector<Running> running;
+    QStringList failed;
+
+    // the handlers are separate processes, waiting for one of them doesn't hold the others back
+    auto finishOldest = [&]() {
+        Running &oldest = running.front();
+        const bool finished = oldest.process->waitForFinished(oldest.deadline.isForever() ? -1 : std::max<qint64>(0, oldest.deadline.remainingTime()));
+        if (!finished && oldest.process->state() != QProcess::NotRunning) {
+            qCWarning(KPACKAGE_LOG) << "Timed out installing dependency" << oldest.dependency;
+            oldest.process->kill();
+            oldest.process->waitForFinished();
+        }
+        const bool ok = finished && oldest.process->exitStatus() == QProcess::NormalExit && oldest.process->exitCode() == 0;
+        if (!ok) {
+            failed << oldest.dependency;
+        }
+        setState(oldest.dependency, ok ? Installed : Failed);
+        running.erase(running.begin());
+    };
+
+    for (const QString &dependency : std::as_const(toInstall)) {
+        const QUrl dependencyUrl(dependency);
+        const QString handler = resolveHandler(dependencyUrl.scheme());
+        if (handler.isEmpty()) {
+            failed << dependency;
+            setState(dependency, Failed);
+            continue;
+        }
+
+        if (running.size() >= size_t(maximumRunning)) {
+            finishOldest();
+        }
+        auto process = std::make_unique<QProcess>();
+        process->setProgram(handler);
+        process->setArguments({dependencyUrl.toString()});
+        process->setProcessChannelMode(QProcess::ForwardedChannels);
+        process->start();
+        running.push_back(Running{dependency, std::move(process), QDeadlineTimer(timeout)});
+    }
+    while (!running.empty()) {
+        finishOldest();
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+        for (const QString &dependency : std::as_const(toWaitFor)) {
+            while (m_states.value(dependency, Failed) == Resolving) {
+                m_stateChanged.wait(&m_mutex);
+            }
+            // a failed attempt was given back, which only happens for a failure of another dependency
+            if (m_states.value(dependency, Failed) != Installed) {
+                failed << dependency;
+            }
+        }
+    }
+
+    // report the first failure in the order of the metadata, as installing one after the other would have
+    for (const QString &dependency : dependencies) {
+        if (failed.contains(dependency)) {
+            *failedDependency = dependency;
+            return false;
+        }
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,51 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPACKAGE_DEPENDENCYRESOLVER_P_H
+#define KPACKAGE_DEPENDENCYRESOLVER_P_H
+
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+#include <QWaitCondition>
+
+namespace KPackage
+{
+/**
+ * Installs the X-KPackage-Dependencies of packages with the handler for their URL scheme,
+ * e.g. kns://plasmoids.knsrc/... goes to the knshandler of KNewStuff.
+ *
+ * The handlers of the dependencies of a package run concurrently, at most KPACKAGE_DEP_RESOLVERS_MAX_JOBS
+ * at a time (4 by default). A handler taking longer than KPACKAGE_DEP_RESOLVERS_TIMEOUT seconds is killed,
+ * when that is set: by default they may take as long as they need, like they always could.
+ * The PackageJobs of a PackageBatchJob share a resolver, so a dependency of several packages of the
+ * batch gets installed once. It is thread-safe.
+ */
+class DependencyResolver
+{
+public:
+    /**
+     * Installs @p dependencies, the ones already installed by this resolver are skipped.
+     * @return whether all of them are installed, @p failedDependency is set to the first one which isn't otherwise
+     */
+    bool resolve(const QStringList &dependencies, QString *failedDependency);
+
+private:
+    enum State {
+        Resolving,
+        Installed,
+        Failed,
+    };
+    void setState(const QString &dependency, State state);
+
+    QMutex m_mutex;
+    QWaitCondition m_stateChanged;
+    QHash<QString, State> m_states;
+};
+
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "private/instrumentation_p.h"
+
+#include <QCoreApplication>
+#include <QTextStream>
+
+#include <array>
+#include <atomic>
+
+#include "kpackage_instrumentation_debug.h"
+
+namespace KPackage
+{
+namespace Instrumentation
+{
+namespace
+{
+struct PhaseStatistics {
+    std::atomic<quint64> count = 0;
+    std::atomic<qint64> nanoseconds = 0;
+};
+
+std::array<PhaseStatistics, PhaseCount> s_phases;
+std::array<std::atomic<quint64>, CounterCount> s_counters = {};
+
+const char *const s_phaseNames[PhaseCount] = {
+    "index reads",
+    "root scans",
+    "metadata parses",
+    "setPath",
+    "file lookups",
+    "archive unpacking",
+};
+
+void dumpAtExit()
+{
+    dump();
+}
+
+bool enabled()
+{
+    const bool enabled = qEnvironmentVariableIntValue("KPACKAGE_INSTRUMENTATION") > 0 || KPACKAGE_INSTRUMENTATION_LOG().isInfoEnabled();
+    if (enabled && QCoreApplication::instance()) {
+        qAddPostRoutine(dumpAtExit);
+    }
+    return enabled;
+}
+
+QString ratio(Counter hits, Counter misses)
+{
+    const quint64 hitCount = s_counters[hits];
+    const quint64 total = hitCount + s_counters[misses];
+    if (total == 0) {
+        return QStringLiteral("unused");
+    }
+    return QStringLiteral("%1/%2 hits (%3%)").arg(hitCount).arg(total).arg(100.0 * hitCount / total, 0, 'f', 1);
+}
+}
+
+bool isEnabled()
+{
+    static const bool s_enabled = enabled();
+    return s_enabled;
+}
+
+void count(Counter counter, quint64 amount)
+{
+    if (isEnabled()) {
+        s_counters[counter].fetch_add(amount, std::memory_order_relaxed);
+    }
+}
+
+void record(Phase phase, qint64 nanoseconds, const QString &detail)
+{
+    s_phases[phase].count.fetch_add(1, std::memory_order_relaxed);
+    s_phases[phase].nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    qCDebug(KPACKAGE_INSTRUMENTATION_LOG).nospace() << s_phaseNames[phase] << ": " << detail << " took " << nanoseconds / 1000 << "us";
+}
+
+QString summary()
+{
+    QString result;
+    QTextStream stream(&result);
+    stream << "KPackage instrumentation summary\n";
+    for (int i = 0; i < PhaseCount; ++i) {
+        const quint64 count = s_phases[i].count;
+        const double milliseconds = s_phases[i].nanoseconds / 1e6;
+        stream << "  " << s_phaseNames[i] << ": " << count << " in " << QString::number(milliseconds, 'f', 3) << " ms\n";
+    }
+    stream << "  files probed by lookups: " << s_counters[FileProbes] << '\n';
+    stream << "  filePath misses: " << s_counters[FilePathMisses] << '\n';
+    stream << "  listing cache: " << ratio(ListingCacheHits, ListingCacheMisses) << '\n';
+    stream << "  file discovery cache: " << ratio(DiscoveryCacheHits, DiscoveryCacheMisses) << '\n';
+    return result;
+}
+
+void dump()
+{
+    // not through the logging category, being enabled from the environment is enough
+    qInfo().noquote() << summary();
+}
+}
+
+}
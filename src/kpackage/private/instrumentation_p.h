@@ -0,0 +1,97 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPACKAGE_INSTRUMENTATION_P_H
+#define KPACKAGE_INSTRUMENTATION_P_H
+
+#include <QElapsedTimer>
+#include <QString>
+
+namespace KPackage
+{
+/**
+ * Opt-in counters for the expensive parts of finding and loading packages.
+ *
+ * Enabled by setting KPACKAGE_INSTRUMENTATION=1 in the environment or by enabling the info
+ * messages of the kf.package.instrumentation logging category. Every phase then records how often
+ * it ran and for how long, the caches how often they could answer. The summary is printed when
+ * the application exits, or whenever dump() is called, which applications do through
+ * PackageLoader::dumpInstrumentation().
+ * With the debug messages of kf.package.instrumentation enabled every span gets logged too, along
+ * with what it worked on, e.g. the package root being scanned.
+ *
+ * When disabled, all it costs is one check of a flag.
+ */
+namespace Instrumentation
+{
+enum Phase {
+    // PackageIndex reading an up to date index of a package root
+    IndexRead,
+    // PackageIndex walking a package root, because its index is missing or outdated
+    RootScan,
+    // parsing a metadata.json
+    MetadataParse,
+    // Package::setPath, resolving and canonicalizing the package path
+    SetPath,
+    // PackagePrivate::findFilePath, looking for a file on disk
+    FileLookup,
+    // opening a package archive or extracting some of it
+    ArchiveUnpack,
+    PhaseCount,
+};
+
+enum Counter {
+    // the files findFilePath checked on disk
+    FileProbes,
+    // filePath calls which found nothing in the package nor its fallbacks
+    FilePathMisses,
+    ListingCacheHits,
+    ListingCacheMisses,
+    DiscoveryCacheHits,
+    DiscoveryCacheMisses,
+    CounterCount,
+};
+
+bool isEnabled();
+void count(Counter counter, quint64 amount = 1);
+void record(Phase phase, qint64 nanoseconds, const QString &detail);
+// @return a human readable summary of everything recorded so far
+QString summary();
+// prints the summary
+void dump();
+
+/**
+ * Records the time until it goes out of scope, if the instrumentation is enabled.
+ */
+class Span
+{
+public:
+    explicit Span(Phase phase, const QString &detail = QString())
+        : m_phase(phase)
+    {
+        if (isEnabled()) {
+            m_detail = detail;
+            m_timer.start();
+        }
+    }
+    ~Span()
+    {
+        if (m_timer.isValid()) {
+            record(m_phase, m_timer.nsecsElapsed(), m_detail);
+        }
+    }
+    Q_DISABLE_COPY_MOVE(Span)
+
+private:
+    const Phase m_phase;
+    QString m_detail;
+    QElapsedTimer m_timer;
+};
+}
+
+}
+
+#endif
@@ -0,0 +1,127 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "private/metadatatable_p.h"
+#include "private/instrumentation_p.h"
+#include "private/utils.h"
+
+#include <QCborMap>
+#include <QCborValue>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QSet>
+
+namespace KPackage
+{
+// @return the one instance of @p value shared by all the tables, for the values repeated over and over
+static QString intern(const QString &value)
+{
+    static QMutex mutex;
+    static QSet<QString> pool;
+    QMutexLocker locker(&mutex);
+    auto it = pool.constFind(value);
+    if (it == pool.constEnd()) {
+        it = pool.insert(value);
+    }
+    return *it;
+}
+
+QByteArray MetadataTable::encode(const KPluginMetaData &metadata)
+{
+    return QCborValue(QCborMap::fromJsonObject(metadata.rawData())).toCbor();
+}
+
+qint64 MetadataTable::metadataModificationTime(const QString &packagePath)
+{
+    const QFileInfo info(packagePath + QLatin1String("/metadata.json"));
+    return info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+}
+
+void MetadataTable::detachDecoded()
+{
+    if (m_decoded.use_count() == 1) {
+        return;
+    }
+    auto decoded = std::make_shared<Decoded>();
+    {
+        QMutexLocker locker(&m_decoded->mutex);
+        decoded->rows = m_decoded->rows;
+    }
+    m_decoded = decoded;
+}
+
+void MetadataTable::append(const KPluginMetaData &metadata, qint64 modificationTime)
+{
+    append(QFileInfo(metadata.fileName()).path(), metadata.pluginId(), readKPackageType(metadata), metadata.category(), modificationTime, encode(metadata));
+    // no point in decoding it again
+    QMutexLocker locker(&m_decoded->mutex);
+    m_decoded->rows.insert(size() - 1, metadata);
+}
+
+void MetadataTable::append(const QString &path,
+                           const QString &pluginId,
+                           const QString &packageFormat,
+                           const QString &category,
+                           qint64 modificationTime,
+                           const QByteArray &encodedMetadata)
+{
+    detachDecoded();
+    m_paths << path;
+    m_pluginIds << pluginId;
+    m_packageFormats << intern(packageFormat);
+    m_categories << intern(category);
+    m_modificationTimes << modificationTime;
+    m_encodedMetadata << encodedMetadata;
+}
+
+void MetadataTable::append(const MetadataTable &other, qsizetype row)
+{
+    append(other.path(row), other.pluginId(row), other.packageFormat(row), other.category(row), other.modificationTime(row), other.encodedMetadata(row));
+    QMutexLocker otherLocker(&other.m_decoded->mutex);
+    if (auto it = other.m_decoded->rows.constFind(row); it != other.m_decoded->rows.constEnd()) {
+        const KPluginMetaData metadata = it.value();
+        otherLocker.unlock();
+        QMutexLocker locker(&m_decoded->mutex);
+        m_decoded->rows.insert(size() - 1, metadata);
+    }
+}
+
+KPluginMetaData MetadataTable::metadata(qsizetype row) const
+{
+    QMutexLocker locker(&m_decoded->mutex);
+    if (auto it = m_decoded->rows.constFind(row); it != m_decoded->rows.constEnd()) {
+        return it.value();
+    }
+    // decoded without holding the lock, another thread may be doing the same meanwhile
+    locker.unlock();
+    const Instrumentation::Span span(Instrumentation::MetadataParse, m_paths.at(row));
+    const QJsonObject json = QCborValue::fromCbor(m_encodedMetadata.at(row)).toMap().toJsonObject();
+    const KPluginMetaData metadata(json, m_paths.at(row) + QLatin1String("/metadata.json"));
+    locker.relock();
+    return *m_decoded->rows.insert(row, metadata);
+}
+
+bool MetadataTable::isUpToDate() const
+{
+    for (qsizetype row = 0; row < size(); ++row) {
+        if (metadataModificationTime(m_paths.at(row)) != m_modificationTimes.at(row)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QList<KPluginMetaData> MetadataTable::toList() const
+{
+    QList<KPluginMetaData> result;
+    result.reserve(size());
+    for (qsizetype row = 0; row < size(); ++row) {
+        result << metadata(row);
+    }
+    return result;
+}
+
+}
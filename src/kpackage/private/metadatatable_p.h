@@ -0,0 +1,117 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPACKAGE_METADATATABLE_P_H
+#define KPACKAGE_METADATATABLE_P_H
+
+#include <KPluginMetaData>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QStringList>
+
+#include <memory>
+
+namespace KPackage
+{
+/**
+ * The metadata of a list of packages, as kept by the package index and the listings of PackageLoader.
+ *
+ * Stored column by column: the package path, plugin id, format and category the loader filters and
+ * queries on, the modification time of the metadata.json file the row was read from, then the metadata
+ * itself in its CBOR encoding. The formats and categories are interned, all the rows of a format share
+ * one string. A KPluginMetaData, with its own JSON tree, is only decoded for the rows somebody asks for
+ * and then kept, shared by all the copies of the table.
+ *
+ * Copies are cheap and the tables can be read from several threads at once.
+ */
+class MetadataTable
+{
+public:
+    // @return the CBOR encoding of the JSON of @p metadata
+    static QByteArray encode(const KPluginMetaData &metadata);
+    // @return the modification time of the metadata.json of the package at @p packagePath,
+    // in milliseconds since the epoch, -1 if there is none
+    static qint64 metadataModificationTime(const QString &packagePath);
+
+    qsizetype size() const
+    {
+        return m_paths.size();
+    }
+    bool isEmpty() const
+    {
+        return m_paths.isEmpty();
+    }
+
+    // adds an already decoded package, read from a metadata.json modified at @p modificationTime
+    void append(const KPluginMetaData &metadata, qint64 modificationTime);
+    // adds a package read back from its encoding, as done by PackageIndex
+    void append(const QString &path,
+                const QString &pluginId,
+                const QString &packageFormat,
+                const QString &category,
+                qint64 modificationTime,
+                const QByteArray &encodedMetadata);
+    // adds row @p row of @p other, along with its decoded metadata if there is any
+    void append(const MetadataTable &other, qsizetype row);
+
+    // absolute path of the package directory, without trailing slash
+    QString path(qsizetype row) const
+    {
+        return m_paths.at(row);
+    }
+    QString pluginId(qsizetype row) const
+    {
+        return m_pluginIds.at(row);
+    }
+    // the KPackageStructure of the package
+    QString packageFormat(qsizetype row) const
+    {
+        return m_packageFormats.at(row);
+    }
+    QString category(qsizetype row) const
+    {
+        return m_categories.at(row);
+    }
+    // of the metadata.json file, see metadataModificationTime
+    qint64 modificationTime(qsizetype row) const
+    {
+        return m_modificationTimes.at(row);
+    }
+    QByteArray encodedMetadata(qsizetype row) const
+    {
+        return m_encodedMetadata.at(row);
+    }
+
+    // @return the metadata of the package in @p row, decoded on first use
+    KPluginMetaData metadata(qsizetype row) const;
+    // @return the metadata of all the packages, in order
+    QList<KPluginMetaData> toList() const;
+    // @return whether the metadata.json of none of the packages changed since the rows were read,
+    // which costs a stat() per package. Packages updated in place don't touch their package root.
+    bool isUpToDate() const;
+
+private:
+    // the rows decoded so far, shared by the copies of the table until one of them gets appended to
+    struct Decoded {
+        QMutex mutex;
+        QHash<qsizetype, KPluginMetaData> rows;
+    };
+    void detachDecoded();
+
+    QStringList m_paths;
+    QStringList m_pluginIds;
+    QStringList m_packageFormats;
+    QStringList m_categories;
+    QList<qint64> m_modificationTimes;
+    QList<QByteArray> m_encodedMetadata;
+    std::shared_ptr<Decoded> m_decoded = std::make_shared<Decoded>();
+};
+
+}
+
+#endif
@@ -8,13 +8,17 @@
 #define KPACKAGE_PACKAGE_P_H
 
 #include "../package.h"
+#include "packagearchive_p.h"
+#include "packagemanifest_p.h"
 
 #include <QCryptographicHash>
 #include <QDir>
 #include <QHash>
 #include <QPointer>
+#include <QSet>
 #include <QSharedData>
 #include <QString>
+#include <memory>
 #include <optional>
 namespace KPackage
 {
@@ -51,22 +55,73 @@ public:
     PackagePrivate &operator=(const PackagePrivate &rhs);
 
     void createPackageMetadata(const QString &path);
+    // opens the package file @p filePath, @return the root its contents get extracted to
     QString unpack(const QString &filePath);
-    void updateHash(const QString &basePath, const QString &subPath, const QDir &dir, QCryptographicHash &hash);
     QString fallbackFilePath(const QByteArray &key, const QString &filename = QString()) const;
-    bool hasCycle(const KPackage::Package &package);
+    // @return the valid packages to look into after this one, in order: the fallback package, its own
+    // fallback package and so on. A root already looked into is skipped, the walk ends at a cycle.
+    QList<const PackagePrivate *> fallbackChain() const;
+    // @return what tells packages apart in a fallback chain: the package path, or the identity of the
+    // package data for packages without a path
+    QString fallbackId() const;
+    // @return the files of @p content in the package, the way entryList returns them without options
+    QStringList listEntries(const ContentStructure &content) const;
+    // drops what filePath and entryList remembered
+    void clearDiscoveries()
+    {
+        discoveries.clear();
+        entries.clear();
+    }
+    // @return the path of the file inside this package, without looking at the discoveries or the fallback package
+    QString findFilePath(const QByteArray &fileType, const QString &filename) const;
+    // @return the manifest of the installed package, nullptr if there is none
+    const PackageManifest *manifest() const;
+    // @return @p file relative to the package path, if it can be looked up in the manifest
+    std::optional<QString> manifestPath(const QString &file) const;
+    // @return whether the fallback chain of @p package loops or leads back to this package
+    bool hasCycle(const KPackage::Package &package) const;
     bool isInsidePackageDir(const QString &canonicalPath) const;
 
+    // @return the state of a new package of @p structure, as set up by its initPackage
+    static QExplicitlySharedDataPointer<PackagePrivate> initializedBy(PackageStructure *structure);
+    // @return a package which sets itself up with @p structure and @p path only once it gets used
+    static Package createLazyPackage(PackageStructure *structure, const QString &path, const KPluginMetaData &metadata);
+    // runs the deferred setup of a package created by createLazyPackage, shared by all its copies
+    void ensureInitialized();
+
+    // @return a copy of @p package and its fallback packages which can be used on another thread:
+    // the only data it shares with them is the archive of package files, PackageArchive locks itself
+    static Package detachedCopy(const Package &package);
+    static Package detachedCopy(const Package &package, QSet<const PackagePrivate *> &copied);
+    // looks up the required files of the detached copy @p package and the files of @p fileTypes,
+    // and asks the system to read the files ahead
+    static void prefetch(Package &package, const QList<QByteArray> &fileTypes);
+    // adds what @p prefetched found out to what @p package knows, its detached copy
+    static void takeDiscoveries(const Package &package, const Package &prefetched);
+
     QPointer<PackageStructure> structure;
     QString path;
     QString tempRoot;
+    // the package file tempRoot is extracted from, if the package was set up from one
+    std::shared_ptr<PackageArchive> archive;
     QStringList contentsPrefixPaths;
     QString defaultPackageRoot;
+    // results of filePath, misses included
     QHash<QString, QString> discoveries;
+    // results of entryList, per key and options
+    QHash<QString, QStringList> entries;
     QHash<QByteArray, ContentStructure> contents;
     std::unique_ptr<Package> fallbackPackage;
+    // the X-Plasma-RootPath the fallback package got loaded for by setPath
+    QString rootPathFallback;
     QStringList mimeTypes;
     std::optional<KPluginMetaData> metadata;
+    // loaded for loadedManifestPath on first use
+    mutable std::shared_ptr<const PackageManifest> loadedManifest;
+    mutable QString loadedManifestPath;
+    // path to set once the package gets used, see createLazyPackage
+    QString lazyPath;
+    bool lazy = false;
     bool externalPaths = false;
     bool valid = false;
     bool checkedValid = false;
@@ -0,0 +1,143 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "private/packagearchive_p.h"
+#include "private/instrumentation_p.h"
+
+#include "kpackage_debug.h"
+
+#include <KArchive>
+#include <KArchiveDirectory>
+#include <KArchiveFile>
+#include <KTar>
+#include <kzip.h>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMimeDatabase>
+#include <qtemporarydir.h>
+
+namespace KPackage
+{
+std::shared_ptr<PackageArchive> PackageArchive::open(const QString &filePath)
+{
+    const Instrumentation::Span span(Instrumentation::ArchiveUnpack, filePath);
+    std::unique_ptr<KArchive> archive;
+    QMimeDatabase db;
+    QMimeType mimeType = db.mimeTypeForFile(filePath);
+
+    if (mimeType.inherits(QStringLiteral("application/zip"))) {
+        archive = std::make_unique<KZip>(filePath);
+    } else if (mimeType.inherits(QStringLiteral("application/x-compressed-tar")) || //
+               mimeType.inherits(QStringLiteral("application/x-gzip")) || //
+               mimeType.inherits(QStringLiteral("application/x-tar")) || //
+               mimeType.inherits(QStringLiteral("application/x-bzip-compressed-tar")) || //
+               mimeType.inherits(QStringLiteral("application/x-xz")) || //
+               mimeType.inherits(QStringLiteral("application/x-lzma"))) {
+        archive = std::make_unique<KTar>(filePath);
+    } else {
+        // qCWarning(KPACKAGE_LOG) << "Could not open package file, unsupported archive format:" << filePath << mimeType.name();
+        return nullptr;
+    }
+
+    if (!archive->open(QIODevice::ReadOnly)) {
+        // qCWarning(KPACKAGE_LOG) << "Could not open package file:" << filePath;
+        return nullptr;
+    }
+
+    QTemporaryDir tempdir;
+    if (!tempdir.isValid()) {
+        return nullptr;
+    }
+    tempdir.setAutoRemove(false);
+
+    std::shared_ptr<PackageArchive> result(new PackageArchive);
+    result->m_packageDirectory = archive->directory();
+    result->m_tempDir = tempdir.path();
+    result->m_root = tempdir.path() + QLatin1Char('/');
+
+    if (!result->m_packageDirectory->file(QStringLiteral("metadata.json"))) {
+        // search metadata.json, the zip file might have the package contents in a subdirectory
+        const QStringList entries = result->m_packageDirectory->entries();
+        for (const QString &entryName : entries) {
+            const KArchiveEntry *entry = result->m_packageDirectory->entry(entryName);
+            if (!entry->isDirectory()) {
+                continue;
+            }
+            const auto directory = static_cast<const KArchiveDirectory *>(entry);
+            if (directory->file(QStringLiteral("metadata.json"))) {
+                result->m_packageDirectory = directory;
+                result->m_root = tempdir.path() + QLatin1Char('/') + entryName + QLatin1Char('/');
+            }
+        }
+        // Package expects its root to exist
+        QDir().mkpath(result->m_root);
+    }
+
+    result->m_archive = std::move(archive);
+    return result;
+}
+
+PackageArchive::~PackageArchive()
+{
+    QDir(m_tempDir).removeRecursively();
+}
+
+QString PackageArchive::root() const
+{
+    return m_root;
+}
+
+KPluginMetaData PackageArchive::metadata() const
+{
+    QMutexLocker locker(&m_mutex);
+    const KArchiveFile *file = m_packageDirectory->file(QStringLiteral("metadata.json"));
+    if (!file) {
+        qCDebug(KPACKAGE_LOG) << "No metadata file in the package, expected it at:" << m_root + QLatin1String("metadata.json");
+        return KPluginMetaData();
+    }
+    const QJsonObject json = QJsonDocument::fromJson(file->data()).object();
+    return KPluginMetaData(json, m_root + QLatin1String("metadata.json"));
+}
+
+void PackageArchive::extract(const QString &relativePath)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_extractedAll || relativePath.isEmpty() || m_extracted.contains(relativePath)) {
+        return;
+    }
+    m_extracted.insert(relativePath);
+    const Instrumentation::Span span(Instrumentation::ArchiveUnpack, relativePath);
+
+    // only plain paths, Package checks whatever else is asked for on the disk
+    const QStringList segments = relativePath.split(QLatin1Char('/'), Qt::SkipEmptyParts);
+    if (segments.contains(QLatin1String(".")) || segments.contains(QLatin1String(".."))) {
+        return;
+    }
+
+    const KArchiveEntry *entry = m_packageDirectory->entry(segments.join(QLatin1Char('/')));
+    if (!entry) {
+        return;
+    }
+
+    const QString destination = m_root + segments.join(QLatin1Char('/'));
+    if (entry->isDirectory()) {
+        QDir().mkpath(destination);
+        static_cast<const KArchiveDirectory *>(entry)->copyTo(destination, true);
+    } else if (!entry->symLinkTarget().isEmpty()) {
+        // the target can be anywhere in the package, don't try to be smart about it
+        m_packageDirectory->copyTo(m_root, true);
+        m_extractedAll = true;
+    } else {
+        const QString parent = QFileInfo(destination).path();
+        QDir().mkpath(parent);
+        static_cast<const KArchiveFile *>(entry)->copyTo(parent);
+    }
+}
+
+}
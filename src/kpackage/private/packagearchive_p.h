@@ -0,0 +1,73 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPACKAGE_PACKAGEARCHIVE_P_H
+#define KPACKAGE_PACKAGEARCHIVE_P_H
+
+#include <KPluginMetaData>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+
+#include <memory>
+
+class KArchive;
+class KArchiveDirectory;
+
+namespace KPackage
+{
+/**
+ * A package file (zip or tar) opened by Package::setPath.
+ *
+ * The archive is kept open and its entries are only extracted into a temporary directory once
+ * Package looks them up, so previewing the metadata of a package file doesn't write it to the disk.
+ * The temporary directory goes away with the last package sharing the archive.
+ *
+ * The packages sharing the archive may be used from different threads, e.g. by a PackagePrefetchJob:
+ * reading the archive is serialized.
+ */
+class PackageArchive
+{
+public:
+    /**
+     * @return the opened package file, nullptr if it isn't a supported archive or can't be read
+     */
+    static std::shared_ptr<PackageArchive> open(const QString &filePath);
+    ~PackageArchive();
+
+    /**
+     * @return the directory the package gets extracted to, with a trailing slash
+     */
+    QString root() const;
+
+    /**
+     * @return the metadata of the package, read from the archive directly
+     */
+    KPluginMetaData metadata() const;
+
+    /**
+     * Extracts the file or directory at @p relativePath, relative to root(), if the archive has it
+     */
+    void extract(const QString &relativePath);
+
+private:
+    PackageArchive() = default;
+    Q_DISABLE_COPY(PackageArchive)
+
+    // guards the reads of the archive and m_extracted
+    mutable QMutex m_mutex;
+    std::unique_ptr<KArchive> m_archive;
+    // the archive may have the package contents in a subdirectory
+    const KArchiveDirectory *m_packageDirectory = nullptr;
+    QString m_tempDir;
+    QString m_root;
+    QSet<QString> m_extracted;
+    bool m_extractedAll = false;
+};
+
+}
+
+#endif
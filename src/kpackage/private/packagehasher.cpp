@@ -0,0 +1,254 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "private/packagehasher_p.h"
+#include "private/parallel_p.h"
+
+#include "kpackage_debug.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+namespace KPackage
+{
+// files up to this size are read in parallel, bigger ones are read in chunks of this size when their turn comes
+static constexpr qint64 s_readLimit = 1024 * 1024;
+// how much file data may be held in memory waiting for its turn
+static constexpr qint64 s_batchBudget = 32 * 1024 * 1024;
+
+void PackageHasher::addFile(Plan &plan, const QString &filePath)
+{
+    Step &step = plan.steps.last();
+    step.filePath = filePath;
+
+    // enough to tell whether the file changed since the cached hash was computed, see git's index
+    QByteArray identity = QFile::encodeName(filePath);
+#ifdef Q_OS_UNIX
+    struct stat info;
+    if (::stat(identity.constData(), &info) == 0) {
+        step.size = info.st_size;
+        identity += QByteArray::number(quint64(info.st_dev)) + ' ' + QByteArray::number(quint64(info.st_ino)) + ' ' + QByteArray::number(qint64(info.st_mtim.tv_sec))
+            + '.' + QByteArray::number(qint64(info.st_mtim.tv_nsec)) + ' ' + QByteArray::number(qint64(info.st_size));
+    }
+#else
+    const QFileInfo info(filePath);
+    step.size = info.size();
+    identity += QByteArray::number(info.lastModified().toMSecsSinceEpoch()) + ' ' + QByteArray::number(info.size());
+#endif
+    plan.fingerprint.addData(identity);
+    plan.fingerprint.addData(QByteArrayView("\0", 1));
+}
+
+void PackageHasher::addDirectory(Plan &plan, const QString &subPath, const QDir &dir)
+{
+    const QDir::SortFlags sorting = QDir::Name | QDir::IgnoreCase;
+    const QDir::Filters filters = QDir::Hidden | QDir::System | QDir::NoDotAndDotDot;
+    const auto lstEntries = dir.entryList(QDir::Files | filters, sorting);
+    for (const QString &file : lstEntries) {
+        Step step;
+        if (!subPath.isEmpty()) {
+            step.data += subPath.toUtf8();
+        }
+        step.data += file.toUtf8();
+
+        QFileInfo info(dir.path() + QLatin1Char('/') + file);
+        if (info.isSymLink()) {
+            step.data += info.symLinkTarget().toUtf8();
+            plan.steps << step;
+        } else {
+            plan.steps << step;
+            addFile(plan, info.filePath());
+        }
+        plan.fingerprint.addData(plan.steps.last().data);
+    }
+
+    const auto lstEntries2 = dir.entryList(QDir::Dirs | filters, sorting);
+    for (const QString &subDirPath : lstEntries2) {
+        const QString relativePath = subPath + subDirPath + QLatin1Char('/');
+        Step step;
+        step.data = relativePath.toUtf8();
+
+        QDir subDir(dir.path());
+        subDir.cd(subDirPath);
+
+        if (subDir.path() != subDir.canonicalPath()) {
+            step.data += subDir.canonicalPath().toUtf8();
+            plan.steps << step;
+            plan.fingerprint.addData(step.data);
+        } else {
+            plan.steps << step;
+            plan.fingerprint.addData(step.data);
+            addDirectory(plan, relativePath, subDir);
+        }
+    }
+}
+
+QString PackageHasher::cacheFilePath(const QString &packagePath, QCryptographicHash::Algorithm algorithm)
+{
+    const QByteArray key = QCryptographicHash::hash(QString(packagePath + QLatin1Char('\n') + QString::number(int(algorithm))).toUtf8(), QCryptographicHash::Sha1);
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QLatin1String("/kpackage/hash/") + QString::fromLatin1(key.toHex());
+}
+
+// Read in chunks rather than mapped: a package file truncated while it gets hashed, by an
+// update for instance, would kill the process with SIGBUS instead of giving a short read
+static void addFileContents(QCryptographicHash &hash, QFile &file)
+{
+    QByteArray buffer(s_readLimit, Qt::Uninitialized);
+    while (!file.atEnd()) {
+        const qint64 read = file.read(buffer.data(), buffer.size());
+        if (read <= 0) {
+            break;
+        }
+        hash.addData(QByteArrayView(buffer.constData(), read));
+    }
+}
+
+QByteArray PackageHasher::hash(const QString &packagePath,
+                               const QStringList &contentsPrefixPaths,
+                               QCryptographicHash::Algorithm algorithm,
+                               const Observer &observer,
+                               CachePolicy cachePolicy)
+{
+    Plan plan;
+    const QString guessedMetaDataJson = packagePath + QLatin1String("metadata.json");
+    const QString metadataPath = QFile::exists(guessedMetaDataJson) ? guessedMetaDataJson : QString();
+    if (!metadataPath.isEmpty()) {
+        plan.steps << Step();
+        addFile(plan, metadataPath);
+    } else {
+        qCWarning(KPACKAGE_LOG) << "no metadata at" << metadataPath;
+    }
+
+    for (const QString &prefix : contentsPrefixPaths) {
+        const QString basePath = packagePath + prefix;
+        QDir dir(basePath);
+
+        if (!dir.exists()) {
+            return QByteArray();
+        }
+
+        // the prefixes take part in the fingerprint, through the paths of the files
+        plan.fingerprint.addData(QFile::encodeName(basePath));
+        addDirectory(plan, QString(), dir);
+    }
+
+    qint64 totalBytes = 0;
+    for (const Step &step : std::as_const(plan.steps)) {
+        totalBytes += step.size;
+    }
+    if (observer.started) {
+        observer.started(totalBytes);
+    }
+    auto isCanceled = [&observer]() {
+        return observer.canceled && *observer.canceled;
+    };
+
+    const QByteArray fingerprint = plan.fingerprint.result();
+    const QString cachePath = cacheFilePath(packagePath, algorithm);
+    if (cachePolicy == UseCache) {
+        QFile cacheFile(cachePath);
+        if (cacheFile.open(QIODevice::ReadOnly)) {
+            QDataStream stream(&cacheFile);
+            QByteArray cachedFingerprint;
+            QByteArray cachedResult;
+            stream >> cachedFingerprint >> cachedResult;
+            if (stream.status() == QDataStream::Ok && cachedFingerprint == fingerprint) {
+                if (observer.progressed) {
+                    observer.progressed(totalBytes);
+                }
+                return cachedResult;
+            }
+        }
+    }
+
+    QCryptographicHash hash(algorithm);
+    QList<QByteArray> contents;
+    qint64 processedBytes = 0;
+    qsizetype batchStart = 0;
+    while (batchStart < plan.steps.size()) {
+        if (isCanceled()) {
+            return QByteArray();
+        }
+
+        // read the small files of the next steps in parallel, up to the budget
+        qsizetype batchEnd = batchStart;
+        qint64 budget = s_batchBudget;
+        while (batchEnd < plan.steps.size() && (batchEnd == batchStart || budget > 0)) {
+            const Step &step = plan.steps.at(batchEnd);
+            if (!step.filePath.isEmpty() && step.size <= s_readLimit) {
+                budget -= step.size;
+            }
+            ++batchEnd;
+        }
+        contents.fill(QByteArray(), batchEnd - batchStart);
+        std::vector<char> loaded(batchEnd - batchStart, false);
+        // written from several threads, one element each
+        QByteArray *contentsData = contents.data();
+        char *loadedData = loaded.data();
+        parallelFor(batchEnd - batchStart, [&](qsizetype i) {
+            const Step &step = plan.steps.at(batchStart + i);
+            if (step.filePath.isEmpty() || step.size > s_readLimit || isCanceled()) {
+                return;
+            }
+            QFile file(step.filePath);
+            if (file.open(QIODevice::ReadOnly)) {
+                contentsData[i] = file.readAll();
+                loadedData[i] = true;
+            }
+        });
+
+        for (qsizetype i = 0; i < batchEnd - batchStart; ++i) {
+            const Step &step = plan.steps.at(batchStart + i);
+            hash.addData(step.data);
+            if (step.filePath.isEmpty()) {
+                continue;
+            }
+            if (loaded[i]) {
+                hash.addData(contents.at(i));
+            } else if (isCanceled()) {
+                return QByteArray();
+            } else if (QFile file(step.filePath); file.open(QIODevice::ReadOnly)) {
+                addFileContents(hash, file);
+            } else {
+                const QFileInfo info(step.filePath);
+                qCWarning(KPACKAGE_LOG) << "could not add" << file.fileName() << "to the hash; file could not be opened for reading. "
+                                        << "permissions fail?" << info.permissions() << info.isFile();
+            }
+            processedBytes += step.size;
+            if (observer.progressed) {
+                observer.progressed(processedBytes);
+            }
+        }
+        batchStart = batchEnd;
+    }
+    if (isCanceled()) {
+        return QByteArray();
+    }
+
+    const QByteArray result = hash.result().toHex();
+
+    QDir().mkpath(QFileInfo(cachePath).path());
+    QSaveFile cacheFile(cachePath);
+    if (cacheFile.open(QIODevice::WriteOnly)) {
+        QDataStream stream(&cacheFile);
+        stream << fingerprint << result;
+        cacheFile.commit();
+    }
+    return result;
+}
+
+}
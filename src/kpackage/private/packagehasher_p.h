@@ -0,0 +1,90 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPACKAGE_PACKAGEHASHER_P_H
+#define KPACKAGE_PACKAGEHASHER_P_H
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <atomic>
+#include <functional>
+
+namespace KPackage
+{
+/**
+ * Computes Package::cryptographicHash.
+ *
+ * The hash is calculated as a function of:
+ * - the contents of metadata.json
+ * - for each contents prefix, files ordered alphabetically by name, with each file's:
+ *      - path relative to the content root
+ *      - file data
+ * - directories ordered alphabetically by name, with each dir's:
+ *      - path relative to the content root
+ *      - file listing (recursing)
+ * symlinks (in both the file and dir case) are handled by adding
+ * the name of the symlink itself and the abs path of what it points to.
+ *
+ * The package is walked once into a plan of what goes into the hash. The files are then read
+ * in parallel and fed to the hash in the order of the plan, large ones are read in chunks when their turn comes.
+ * The result is cached in GenericCacheLocation/kpackage/hash along with the identity (inode,
+ * modification time and size) of every file and the listing of the package, which makes hashing
+ * an unchanged package cost one walk of its directories. Verifying a package bypasses the cache:
+ * the identity of a file doesn't tell whether its contents got damaged or tampered with.
+ */
+class PackageHasher
+{
+public:
+    enum CachePolicy {
+        UseCache,
+        // the files are always read, for verifying: the result still gets cached
+        BypassCache,
+    };
+
+    // lets PackageJob follow and cancel the hashing, called on the hashing thread
+    struct Observer {
+        // the amount of file data to hash, known once the package is walked
+        std::function<void(qint64 totalBytes)> started;
+        std::function<void(qint64 processedBytes)> progressed;
+        const std::atomic_bool *canceled = nullptr;
+    };
+
+    /**
+     * @return the hex encoded hash of the package at @p packagePath, which ends with a slash, empty
+     * if one of @p contentsPrefixPaths doesn't exist or the hashing got canceled
+     */
+    static QByteArray hash(const QString &packagePath,
+                           const QStringList &contentsPrefixPaths,
+                           QCryptographicHash::Algorithm algorithm,
+                           const Observer &observer = Observer(),
+                           CachePolicy cachePolicy = UseCache);
+
+private:
+    struct Step {
+        // added to the hash as is: file names, relative paths and symlink targets
+        QByteArray data;
+        // the file whose contents are added after data, if any
+        QString filePath;
+        qint64 size = 0;
+    };
+    struct Plan {
+        QList<Step> steps;
+        // identifies the package as it was when the plan was made, see cacheFilePath
+        QCryptographicHash fingerprint{QCryptographicHash::Sha1};
+    };
+
+    static void addFile(Plan &plan, const QString &filePath);
+    static void addDirectory(Plan &plan, const QString &subPath, const QDir &dir);
+    static QString cacheFilePath(const QString &packagePath, QCryptographicHash::Algorithm algorithm);
+};
+
+}
+
+#endif
@@ -0,0 +1,339 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "private/packageindex_p.h"
+#include "private/instrumentation_p.h"
+#include "private/parallel_p.h"
+
+#include "kpackage_debug.h"
+
+#include <QCborArray>
+#include <QCborMap>
+#include <QCborValue>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace KPackage
+{
+// bump whenever the layout or the way of gathering the index changes, older files are then simply regenerated
+static const int s_indexVersion = 4;
+
+static qint64 modificationTime(const QString &path)
+{
+    const QFileInfo info(path);
+    return info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+}
+
+static QString indexFileName(const QString &packageRoot)
+{
+    return QString::fromLatin1(QCryptographicHash::hash(QDir::cleanPath(packageRoot).toUtf8(), QCryptographicHash::Sha1).toHex());
+}
+
+QString PackageIndex::indexFilePath(const QString &packageRoot)
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QLatin1String("/kpackage/index/") + indexFileName(packageRoot);
+}
+
+QString PackageIndex::sharedIndexFilePath(const QString &packageRoot)
+{
+    const QString root = QDir::cleanPath(packageRoot);
+    // the data directory of the user comes first, nobody else reads an index written there
+    const QString userDirectory = QDir::cleanPath(QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation));
+    const QStringList dataDirectories = QStandardPaths::standardLocations(QStandardPaths::GenericDataLocation);
+    for (const QString &dataDirectory : dataDirectories) {
+        const QString directory = QDir::cleanPath(dataDirectory);
+        if (directory == userDirectory) {
+            continue;
+        }
+        if (root.startsWith(directory + QLatin1Char('/'))) {
+            return directory + QLatin1String("/kpackage/index/") + indexFileName(root);
+        }
+    }
+    return QString();
+}
+
+bool PackageIndex::generateSharedIndex(const QString &packageRoot)
+{
+    const QString root = QDir::cleanPath(packageRoot);
+    const QString indexPath = sharedIndexFilePath(root);
+    const qint64 rootModificationTime = modificationTime(root);
+    if (indexPath.isEmpty() || rootModificationTime < 0) {
+        return false;
+    }
+    return write(indexPath, root, rootModificationTime, scan(root));
+}
+
+bool PackageIndex::removeSharedIndex(const QString &packageRoot)
+{
+    const QString indexPath = sharedIndexFilePath(packageRoot);
+    return !indexPath.isEmpty() && QFile::remove(indexPath);
+}
+
+MetadataTable PackageIndex::entries(const QString &packageRoot)
+{
+    const QString root = QDir::cleanPath(packageRoot);
+    // take the time before scanning, if the root changes while we are scanning
+    // the index will be considered outdated on the next call
+    const qint64 rootModificationTime = modificationTime(root);
+    if (rootModificationTime < 0) {
+        return {};
+    }
+
+    if (auto cached = read(indexFilePath(root), root, rootModificationTime)) {
+        return *cached;
+    }
+    // no need to copy it into the user's cache, it stays around for the next time
+    if (const QString sharedIndexPath = sharedIndexFilePath(root); !sharedIndexPath.isEmpty()) {
+        if (auto shared = read(sharedIndexPath, root, rootModificationTime)) {
+            return *shared;
+        }
+    }
+
+    const MetadataTable result = scan(root);
+    write(indexFilePath(root), root, rootModificationTime, result);
+    return result;
+}
+
+bool PackageIndex::update(const QString &packageRoot)
+{
+    const QString root = QDir::cleanPath(packageRoot);
+    const qint64 rootModificationTime = modificationTime(root);
+    const QString sharedIndexPath = sharedIndexFilePath(root);
+    // the shared index is kept up to date by whoever may write it, i.e. installs for all users
+    const bool updateShared = !sharedIndexPath.isEmpty() && QFileInfo(sharedIndexPath).isWritable();
+    if (rootModificationTime < 0) {
+        QFile::remove(indexFilePath(root));
+        if (updateShared) {
+            QFile::remove(sharedIndexPath);
+        }
+        return false;
+    }
+    const MetadataTable entries = scan(root);
+    if (updateShared) {
+        write(sharedIndexPath, root, rootModificationTime, entries);
+    }
+    return write(indexFilePath(root), root, rootModificationTime, entries);
+}
+
+// Packages are looked for at a bounded depth: <root>/<package>/metadata.json, or
+// <root>/<package>/<subdirectory>/metadata.json for the layout of packages unpacked from an
+// archive which has the package in a subdirectory, see PackagePrivate::unpack. There is no point
+// in descending into the contents of the packages, they can't contain other packages.
+#ifdef Q_OS_UNIX
+static bool isDirectoryAt(int dirFd, const char *name, unsigned char type)
+{
+    if (type == DT_DIR) {
+        return true;
+    }
+    // symlinked packages are followed, DT_UNKNOWN happens on filesystems without d_type support
+    struct stat info;
+    return (type == DT_LNK || type == DT_UNKNOWN) && fstatat(dirFd, name, &info, 0) == 0 && S_ISDIR(info.st_mode);
+}
+
+static bool hasMetadataAt(int dirFd, const QByteArray &relativePath)
+{
+    struct stat info;
+    return fstatat(dirFd, relativePath.constData(), &info, 0) == 0 && S_ISREG(info.st_mode);
+}
+
+template<typename Callback>
+static void forEachSubdirectory(int dirFd, Callback callback)
+{
+    // fdopendir takes ownership of the descriptor it is given
+    const int iterationFd = fcntl(dirFd, F_DUPFD_CLOEXEC, 0);
+    DIR *dir = iterationFd >= 0 ? fdopendir(iterationFd) : nullptr;
+    if (!dir) {
+        if (iterationFd >= 0) {
+            close(iterationFd);
+        }
+        return;
+    }
+    while (const dirent *entry = readdir(dir)) {
+        // skips ".", ".." and hidden directories, like the staging directories of PackageJob
+        if (entry->d_name[0] == '.' || !isDirectoryAt(dirFd, entry->d_name, entry->d_type)) {
+            continue;
+        }
+        callback(QByteArray(entry->d_name));
+    }
+    closedir(dir);
+}
+
+// @return the directories of @p packageRoot which contain a metadata.json file
+static QStringList findPackageDirectories(const QString &packageRoot)
+{
+    QStringList result;
+    const QByteArray encodedRoot = QFile::encodeName(packageRoot);
+    const int rootFd = open(encodedRoot.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootFd < 0) {
+        return result;
+    }
+
+    const QByteArray metadataFileName = QByteArrayLiteral("/metadata.json");
+    auto addPackage = [&result, &packageRoot](const QByteArray &relativePath) {
+        result << packageRoot + QLatin1Char('/') + QFile::decodeName(relativePath);
+    };
+
+    forEachSubdirectory(rootFd, [&](const QByteArray &name) {
+        if (hasMetadataAt(rootFd, name + metadataFileName)) {
+            addPackage(name);
+            return;
+        }
+        const int packageFd = openat(rootFd, name.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (packageFd < 0) {
+            return;
+        }
+        forEachSubdirectory(packageFd, [&](const QByteArray &subName) {
+            if (hasMetadataAt(packageFd, subName + metadataFileName)) {
+                addPackage(name + '/' + subName);
+            }
+        });
+        close(packageFd);
+    });
+    close(rootFd);
+    return result;
+}
+#else
+// @return the directories of @p packageRoot which contain a metadata.json file
+static QStringList findPackageDirectories(const QString &packageRoot)
+{
+    QStringList result;
+    auto addPackage = [&result](const QString &path) {
+        if (!QFileInfo(path + QLatin1String("/metadata.json")).isFile()) {
+            return false;
+        }
+        result << path;
+        return true;
+    };
+
+    const QDir root(packageRoot);
+    const QStringList packages = root.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &package : packages) {
+        const QString packagePath = packageRoot + QLatin1Char('/') + package;
+        if (addPackage(packagePath)) {
+            continue;
+        }
+        const QStringList subdirectories = QDir(packagePath).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+        for (const QString &subdirectory : subdirectories) {
+            addPackage(packagePath + QLatin1Char('/') + subdirectory);
+        }
+    }
+    return result;
+}
+#endif
+
+MetadataTable PackageIndex::scan(const QString &packageRoot)
+{
+    const Instrumentation::Span span(Instrumentation::RootScan, packageRoot);
+    const QStringList directories = findPackageDirectories(packageRoot);
+
+    // parsing the metadata is the expensive part, the order of the directories is kept
+    QList<KPluginMetaData> parsed(directories.size());
+    QList<qint64> modificationTimes(directories.size());
+    KPluginMetaData *output = parsed.data();
+    qint64 *outputTimes = modificationTimes.data();
+    parallelFor(directories.size(), [&directories, output, outputTimes](qsizetype i) {
+        const Instrumentation::Span span(Instrumentation::MetadataParse, directories.at(i));
+        // taken first, a file changing while it gets parsed is then seen as outdated
+        outputTimes[i] = MetadataTable::metadataModificationTime(directories.at(i));
+        output[i] = KPluginMetaData::fromJsonFile(directories.at(i) + QLatin1String("/metadata.json"));
+    });
+
+    MetadataTable result;
+    for (qsizetype i = 0; i < parsed.size(); ++i) {
+        if (parsed.at(i).isValid()) {
+            result.append(parsed.at(i), modificationTimes.at(i));
+        }
+    }
+    return result;
+}
+
+std::optional<MetadataTable> PackageIndex::read(const QString &indexPath, const QString &packageRoot, qint64 rootModificationTime)
+{
+    const Instrumentation::Span span(Instrumentation::IndexRead, packageRoot);
+    QFile file(indexPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return std::nullopt;
+    }
+
+    const qint64 size = file.size();
+    uchar *data = size > 0 ? file.map(0, size) : nullptr;
+    if (!data) {
+        return std::nullopt;
+    }
+    // the decoded value holds its own copy of the data, so the mapping can go right away
+    const QCborMap index = QCborValue::fromCbor(QByteArray::fromRawData(reinterpret_cast<const char *>(data), size)).toMap();
+    file.unmap(data);
+
+    if (index.value(QLatin1String("version")).toInteger() != s_indexVersion //
+        || index.value(QLatin1String("root")).toString() != packageRoot //
+        || index.value(QLatin1String("mtime")).toInteger() != rootModificationTime) {
+        return std::nullopt;
+    }
+
+    const QCborArray packages = index.value(QLatin1String("packages")).toArray();
+    MetadataTable result;
+    for (const QCborValue &value : packages) {
+        const QCborMap package = value.toMap();
+        result.append(package.value(QLatin1String("path")).toString(),
+                      package.value(QLatin1String("id")).toString(),
+                      package.value(QLatin1String("format")).toString(),
+                      package.value(QLatin1String("category")).toString(),
+                      package.value(QLatin1String("mtime")).toInteger(),
+                      package.value(QLatin1String("metadata")).toByteArray());
+    }
+    // a package updated in place, e.g. by a package manager renaming a new metadata.json over the old one,
+    // doesn't change the modification time of the root
+    if (!result.isUpToDate()) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+bool PackageIndex::write(const QString &indexPath, const QString &packageRoot, qint64 rootModificationTime, const MetadataTable &entries)
+{
+    QCborArray packages;
+    for (qsizetype i = 0; i < entries.size(); ++i) {
+        packages.append(QCborMap{
+            {QLatin1String("path"), entries.path(i)},
+            {QLatin1String("id"), entries.pluginId(i)},
+            {QLatin1String("format"), entries.packageFormat(i)},
+            {QLatin1String("category"), entries.category(i)},
+            {QLatin1String("mtime"), entries.modificationTime(i)},
+            // a byte string, decoded only when the metadata gets used
+            {QLatin1String("metadata"), entries.encodedMetadata(i)},
+        });
+    }
+    const QCborMap index{
+        {QLatin1String("version"), s_indexVersion},
+        {QLatin1String("root"), packageRoot},
+        {QLatin1String("mtime"), rootModificationTime},
+        {QLatin1String("packages"), packages},
+    };
+
+    QDir().mkpath(QFileInfo(indexPath).path());
+    // QSaveFile renames into place, so concurrent readers never see a partially written index
+    QSaveFile file(indexPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCDebug(KPACKAGE_LOG) << "Could not write package index" << indexPath << file.errorString();
+        return false;
+    }
+    file.write(QCborValue(index).toCbor());
+    return file.commit();
+}
+
+}
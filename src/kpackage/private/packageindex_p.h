@@ -0,0 +1,86 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPACKAGE_PACKAGEINDEX_P_H
+#define KPACKAGE_PACKAGEINDEX_P_H
+
+#include "private/metadatatable_p.h"
+
+#include <QString>
+
+#include <optional>
+
+namespace KPackage
+{
+/**
+ * Binary cache of the metadata of all the packages found inside one package root.
+ *
+ * There is one index file per root in the user's cache directory. It records the modification
+ * time the root had when it was generated, and the one of the metadata.json of every package:
+ * as long as no package directory was added to or removed from the root and no metadata was
+ * replaced, listing it costs a stat() of the root and of each metadata file and a memory mapped
+ * read of the index instead of a walk of the whole tree and a JSON parse per package.
+ *
+ * The metadata of each package is kept in its CBOR encoding, reading the index doesn't decode
+ * any of it: see MetadataTable.
+ *
+ * System-wide roots can also get a shared index, generated by kpackagetool6 --generate-index
+ * into the data directory the root is in, e.g. /usr/share/kpackage/index for /usr/share/plasma/plasmoids.
+ * Every process of every user reads that same file instead of scanning the root on its own. It is
+ * used when there is no up to date index in the user's cache, and validated the same way.
+ * Per-user roots, the ones in the data directory of the user, keep their index in the cache of
+ * the user only, PackageLoader lists them first.
+ *
+ * What gets shared is the I/O: the file is mapped only while it is read, each process still has its
+ * own copy of the table, the encoded metadata included. Keeping the mapping around for the lifetime
+ * of the table would save that memory, at the cost of a SIGBUS whenever the file gets truncated by
+ * an update while a process still uses it.
+ */
+class PackageIndex
+{
+public:
+    /**
+     * @return the packages inside @p packageRoot. They come from the index if it is up to date,
+     * otherwise the root is scanned and the index is regenerated.
+     */
+    static MetadataTable entries(const QString &packageRoot);
+
+    /**
+     * Scans @p packageRoot and rewrites its index. Meant to be called after a package
+     * was installed into or removed from the root.
+     */
+    static bool update(const QString &packageRoot);
+
+    /**
+     * @return the location of the index file of @p packageRoot
+     */
+    static QString indexFilePath(const QString &packageRoot);
+
+    /**
+     * @return the location of the index of @p packageRoot shared by all the users,
+     * empty if the root is not inside one of the data directories
+     */
+    static QString sharedIndexFilePath(const QString &packageRoot);
+
+    /**
+     * Scans @p packageRoot and writes its shared index, which update() then keeps up to date.
+     */
+    static bool generateSharedIndex(const QString &packageRoot);
+
+    /**
+     * Removes the shared index of @p packageRoot, if there is one.
+     */
+    static bool removeSharedIndex(const QString &packageRoot);
+
+private:
+    static MetadataTable scan(const QString &packageRoot);
+    static std::optional<MetadataTable> read(const QString &indexPath, const QString &packageRoot, qint64 rootModificationTime);
+    static bool write(const QString &indexPath, const QString &packageRoot, qint64 rootModificationTime, const MetadataTable &entries);
+};
+
+}
+
+#endif
@@ -6,6 +6,12 @@
 */
 
 #include "private/packagejobthread_p.h"
+#include "private/copyengine_p.h"
+#include "private/dependencyresolver_p.h"
+#include "private/packagehasher_p.h"
+#include "private/packageindex_p.h"
+#include "private/packagemanifest_p.h"
+#include "private/packagetrash_p.h"
 #include "private/utils.h"
 
 #include "config-package.h"
@@ -21,53 +27,20 @@
 #include <QFile>
 #include <QIODevice>
 #include <QJsonDocument>
+#include <QJsonObject>
 #include <QMimeDatabase>
 #include <QMimeType>
-#include <QProcess>
 #include <QRegularExpression>
 #include <QStandardPaths>
+#include <QThreadPool>
 #include <QUrl>
 #include <qtemporarydir.h>
 
+#include <memory>
+#include <optional>
+
 namespace KPackage
 {
-bool copyFolder(QString sourcePath, QString targetPath)
-{
-    QDir source(sourcePath);
-    if (!source.exists()) {
-        return false;
-    }
-
-    QDir target(targetPath);
-    if (!target.exists()) {
-        QString targetName = target.dirName();
-        target.cdUp();
-        target.mkdir(targetName);
-        target = QDir(targetPath);
-    }
-
-    const auto lstEntries = source.entryList(QDir::Files);
-    for (const QString &fileName : lstEntries) {
-        QString sourceFilePath = sourcePath + QDir::separator() + fileName;
-        QString targetFilePath = targetPath + QDir::separator() + fileName;
-
-        if (!QFile::copy(sourceFilePath, targetFilePath)) {
-            return false;
-        }
-    }
-    const auto lstEntries2 = source.entryList(QDir::AllDirs | QDir::NoDotAndDotDot);
-    for (const QString &subFolderName : lstEntries2) {
-        QString sourceSubFolderPath = sourcePath + QDir::separator() + subFolderName;
-        QString targetSubFolderPath = targetPath + QDir::separator() + subFolderName;
-
-        if (!copyFolder(sourceSubFolderPath, targetSubFolderPath)) {
-            return false;
-        }
-    }
-
-    return true;
-}
-
 bool removeFolder(QString folderPath)
 {
     QDir folder(folderPath);
@@ -81,6 +54,11 @@ public:
     QString errorMessage;
     std::function<void()> run;
     int errorCode;
+    bool updateIndex = true;
+    std::shared_ptr<DependencyResolver> dependencyResolver = std::make_shared<DependencyResolver>();
+    QCryptographicHash::Algorithm hashAlgorithm = QCryptographicHash::Sha1;
+    QByteArray expectedHash;
+    std::shared_ptr<const std::atomic_bool> canceled;
 };
 
 PackageJobThread::PackageJobThread(PackageJob::OperationType type, const QString &src, const QString &dest, const KPackage::Package &package)
@@ -103,6 +81,12 @@ PackageJobThread::PackageJobThread(PackageJob::OperationType type, const QString
             uninstall(packagePath);
         };
 
+    } else if (type == PackageJob::Verify) {
+        const QString packagePath = package.path();
+        const QStringList contentsPrefixPaths = package.contentsPrefixPaths();
+        d->run = [this, packagePath, contentsPrefixPaths]() {
+            verify(packagePath, contentsPrefixPaths);
+        };
     } else {
         Q_UNREACHABLE();
     }
@@ -113,6 +97,23 @@ PackageJobThread::~PackageJobThread()
     delete d;
 }
 
+void PackageJobThread::setUpdateIndex(bool updateIndex)
+{
+    d->updateIndex = updateIndex;
+}
+
+void PackageJobThread::setDependencyResolver(const std::shared_ptr<DependencyResolver> &resolver)
+{
+    d->dependencyResolver = resolver;
+}
+
+void PackageJobThread::setVerification(QCryptographicHash::Algorithm algorithm, const QByteArray &expectedHash, const std::shared_ptr<const std::atomic_bool> &canceled)
+{
+    d->hashAlgorithm = algorithm;
+    d->expectedHash = expectedHash;
+    d->canceled = canceled;
+}
+
 void PackageJobThread::run()
 {
     Q_ASSERT(d->run);
@@ -121,38 +122,49 @@ void PackageJobThread::run()
 bool PackageJobThread::install(const QString &src, const QString &dest, const Package &package)
 {
     bool ok = installPackage(src, dest, package, PackageJob::Install);
+    if (ok && d->updateIndex) {
+        PackageIndex::update(dest);
+    }
+    // what a crashed process may have left in the trash
+    PackageTrash::scheduleCleanup(dest);
     Q_EMIT installPathChanged(d->installPath);
     Q_EMIT jobThreadFinished(ok, errorCode(), d->errorMessage);
     return ok;
 }
 
-static QString resolveHandler(const QString &scheme)
+bool PackageJobThread::isValidPluginId(const QString &pluginId)
 {
-    QString envOverride = qEnvironmentVariable("KPACKAGE_DEP_RESOLVERS_PATH");
-    QStringList searchDirs;
-    if (!envOverride.isEmpty()) {
-        searchDirs.push_back(envOverride);
+    // Ensure that package names are safe so package uninstall can't inject
+    // bad characters into the paths used for removal.
+    // Only allow letters, numbers, underscore and period, but no leading period: hidden directories like
+    // the trash and the staging directories of the package root are no packages, ".." is no directory of it.
+    const QRegularExpression validatePluginName(QStringLiteral("^[\\w\\-][\\w\\-\\.]*$"));
+    if (!validatePluginName.match(pluginId).hasMatch()) {
+        // qCDebug(KPACKAGE_LOG) << "Package plugin id " << pluginId << "contains invalid characters";
+        d->errorMessage = i18n("Package plugin id %1 contains invalid characters", pluginId);
+        d->errorCode = PackageJob::JobError::PluginIdInvalidError;
+        return false;
     }
-    searchDirs.append(QStringLiteral(KDE_INSTALL_FULL_LIBEXECDIR_KF "/kpackagehandlers"));
-    // We have to use QStandardPaths::findExecutable here to handle the .exe suffix on Windows.
-    return QStandardPaths::findExecutable(scheme + QLatin1String("handler"), searchDirs);
+    return true;
 }
 
-bool PackageJobThread::installDependency(const QUrl &destUrl)
+bool PackageJobThread::isInstallable(const QString &pluginId, const QString &dest, PackageJob::OperationType operation)
 {
-    auto handler = resolveHandler(destUrl.scheme());
-    if (handler.isEmpty()) {
+    if (pluginId.isEmpty() || pluginId == QLatin1String("metadata")) {
+        // the plugin id may still come from the package structure or the file name
+        return true;
+    }
+    if (!isValidPluginId(pluginId)) {
         return false;
     }
-
-    QProcess process;
-    process.setProgram(handler);
-    process.setArguments({destUrl.toString()});
-    process.setProcessChannelMode(QProcess::ForwardedChannels);
-    process.start();
-    process.waitForFinished();
-
-    return process.exitCode() == 0;
+    const QString targetName = QDir(dest).filePath(pluginId);
+    if (operation == PackageJob::Install && QFile::exists(targetName)) {
+        d->errorMessage = i18n("%1 already exists", targetName);
+        d->errorCode = PackageJob::JobError::PackageAlreadyInstalledError;
+        d->installPath = targetName;
+        return false;
+    }
+    return true;
 }
 
 bool PackageJobThread::installPackage(const QString &src, const QString &dest, const Package &package, PackageJob::OperationType operation)
@@ -176,7 +188,8 @@ bool PackageJobThread::installPackage(const QString &src, const QString &dest, c
     }
 
     QString path;
-    QTemporaryDir tempdir;
+    // archives get extracted next to their final location, so they can be moved in place with a rename
+    std::optional<QTemporaryDir> stagingDir;
     bool archivedPackage = false;
 
     if (fileInfo.isDir()) {
@@ -187,17 +200,17 @@ bool PackageJobThread::installPackage(const QString &src, const QString &dest, c
             path.append(QLatin1Char('/'));
         }
     } else {
-        KArchive *archive = nullptr;
+        std::unique_ptr<KArchive> archive;
         QMimeDatabase db;
         QMimeType mimetype = db.mimeTypeForFile(src);
         if (mimetype.inherits(QStringLiteral("application/zip"))) {
-            archive = new KZip(src);
+            archive = std::make_unique<KZip>(src);
         } else if (mimetype.inherits(QStringLiteral("application/x-compressed-tar")) || //
                    mimetype.inherits(QStringLiteral("application/x-tar")) || //
                    mimetype.inherits(QStringLiteral("application/x-bzip-compressed-tar")) || //
                    mimetype.inherits(QStringLiteral("application/x-xz")) || //
                    mimetype.inherits(QStringLiteral("application/x-lzma"))) {
-            archive = new KTar(src);
+            archive = std::make_unique<KTar>(src);
         } else {
             // qCWarning(KPACKAGE_LOG) << "Could not open package file, unsupported archive format:" << src << mimetype.name();
             d->errorMessage = i18n("Could not open package file, unsupported archive format: %1 %2", src, mimetype.name());
@@ -207,29 +220,57 @@ bool PackageJobThread::installPackage(const QString &src, const QString &dest, c
 
         if (!archive->open(QIODevice::ReadOnly)) {
             // qCWarning(KPACKAGE_LOG) << "Could not open package file:" << src;
-            delete archive;
             d->errorMessage = i18n("Could not open package file: %1", src);
             d->errorCode = PackageJob::JobError::PackageOpenError;
             return false;
         }
 
         archivedPackage = true;
-        path = tempdir.path() + QLatin1Char('/');
-
-        d->installPath = path;
 
         const KArchiveDirectory *source = archive->directory();
-        source->copyTo(path);
-
+        QString packageDirectoryName;
         QStringList entries = source->entries();
         if (entries.count() == 1) {
             const KArchiveEntry *entry = source->entry(entries[0]);
             if (entry->isDirectory()) {
-                path = path + entry->name() + QLatin1Char('/');
+                source = static_cast<const KArchiveDirectory *>(entry);
+                packageDirectoryName = entry->name();
             }
         }
 
-        delete archive;
+        // bail out before extracting anything if the metadata already tells it can't be installed
+        if (const KArchiveFile *metadataFile = source->file(QStringLiteral("metadata.json"))) {
+            const QString pluginId = QJsonDocument::fromJson(metadataFile->data()).object().value(QLatin1String("KPlugin")).toObject().value(QLatin1String("Id")).toString();
+            if (!isInstallable(pluginId, dest, operation)) {
+                return false;
+            }
+        }
+
+        // hidden, so listings of the package root skip it
+        stagingDir.emplace(QDir(dest).filePath(QStringLiteral(".kpackage-install-XXXXXX")));
+        if (!stagingDir->isValid()) {
+            d->errorMessage = i18n("Could not create package root directory: %1", dest);
+            d->errorCode = PackageJob::JobError::RootCreationError;
+            return false;
+        }
+        // QTemporaryDir creates the staging directory for its owner only, the package gets a directory
+        // of its own inside it which has the permissions of any other directory
+        path = stagingDir->filePath(QStringLiteral("package")) + QLatin1Char('/');
+        if (!QDir().mkdir(path)) {
+            d->errorMessage = i18n("Could not create package root directory: %1", dest);
+            d->errorCode = PackageJob::JobError::RootCreationError;
+            return false;
+        }
+        d->installPath = path;
+
+        if (!source->copyTo(path)) {
+            d->errorMessage = i18n("Could not open package file: %1", src);
+            d->errorCode = PackageJob::JobError::PackageOpenError;
+            return false;
+        }
+        if (!packageDirectoryName.isEmpty()) {
+            path = path + packageDirectoryName + QLatin1Char('/');
+        }
     }
 
     Package copyPackage = package;
@@ -250,13 +291,7 @@ bool PackageJobThread::installPackage(const QString &src, const QString &dest, c
         return false;
     }
 
-    // Ensure that package names are safe so package uninstall can't inject
-    // bad characters into the paths used for removal.
-    const QRegularExpression validatePluginName(QStringLiteral("^[\\w\\-\\.]+$")); // Only allow letters, numbers, underscore and period.
-    if (!validatePluginName.match(pluginName).hasMatch()) {
-        // qCDebug(KPACKAGE_LOG) << "Package plugin id " << pluginName << "contains invalid characters";
-        d->errorMessage = i18n("Package plugin id %1 contains invalid characters", pluginName);
-        d->errorCode = PackageJob::JobError::PluginIdInvalidError;
+    if (!isValidPluginId(pluginName)) {
         return false;
     }
 
@@ -266,6 +301,7 @@ bool PackageJobThread::installPackage(const QString &src, const QString &dest, c
     }
     targetName.append(pluginName);
 
+    bool replaceInstalled = false;
     if (QFile::exists(targetName)) {
         if (operation == PackageJob::Update) {
             KPluginMetaData oldMeta;
@@ -277,11 +313,8 @@ bool PackageJobThread::installPackage(const QString &src, const QString &dest, c
                 d->errorMessage = i18n("The new package has a different type from the old version already installed.");
                 d->errorCode = PackageJob::JobError::UpdatePackageTypeMismatchError;
             } else if (isVersionNewer(oldMeta.version(), meta.version())) {
-                const bool ok = uninstallPackage(targetName);
-                if (!ok) {
-                    d->errorMessage = i18n("Impossible to remove the old installation of %1 located at %2. error: %3", pluginName, targetName, d->errorMessage);
-                    d->errorCode = PackageJob::JobError::OldVersionRemovalError;
-                }
+                // the old version gets swapped with the new one once it is staged
+                replaceInstalled = true;
             } else {
                 d->errorMessage = i18n("Not installing version %1 of %2. Version %3 already installed.", meta.version(), meta.pluginId(), oldMeta.version());
                 d->errorCode = PackageJob::JobError::NewerVersionAlreadyInstalledError;
@@ -300,24 +333,54 @@ bool PackageJobThread::installPackage(const QString &src, const QString &dest, c
     // install dependencies
     const QStringList optionalDependencies{QStringLiteral("sddmtheme.knsrc")};
     const QStringList dependencies = meta.value(QStringLiteral("X-KPackage-Dependencies"), QStringList());
+    QStringList requiredDependencies;
     for (const QString &dep : dependencies) {
         QUrl depUrl(dep);
-        const QString knsrcFilePath = QStandardPaths::locate(QStandardPaths::GenericDataLocation, QLatin1String("knsrcfiles/") + depUrl.host());
-        if (knsrcFilePath.isEmpty() && optionalDependencies.contains(depUrl.host())) {
+        if (optionalDependencies.contains(depUrl.host())
+            && QStandardPaths::locate(QStandardPaths::GenericDataLocation, QLatin1String("knsrcfiles/") + depUrl.host()).isEmpty()) {
             qWarning() << "Skipping depdendency due to knsrc files being missing" << depUrl;
             continue;
         }
-        if (!installDependency(depUrl)) {
-            d->errorMessage = i18n("Could not install dependency: '%1'", dep);
-            d->errorCode = PackageJob::JobError::PackageCopyError;
-            return false;
-        }
+        requiredDependencies << dep;
+    }
+    if (QString failedDependency; !d->dependencyResolver->resolve(requiredDependencies, &failedDependency)) {
+        d->errorMessage = i18n("Could not install dependency: '%1'", failedDependency);
+        d->errorCode = PackageJob::JobError::PackageCopyError;
+        return false;
     }
 
-    if (archivedPackage) {
-        // it's in a temp dir, so just move it over.
-        const bool ok = copyFolder(path, targetName);
-        removeFolder(path);
+    if (replaceInstalled) {
+        QString stagedPath = path;
+        if (!archivedPackage) {
+            // stage a copy next to the installed version, which stays in place until the swap. Like for archives
+            // the copy goes into a subdirectory, copyTree creates it with the usual permissions
+            stagingDir.emplace(QDir(dest).filePath(QStringLiteral(".kpackage-install-XXXXXX")));
+            stagedPath = stagingDir->filePath(QStringLiteral("package"));
+            if (!stagingDir->isValid() || !CopyEngine::copyTree(path, stagedPath)) {
+                d->errorMessage = i18n("Could not copy package to destination: %1", targetName);
+                d->errorCode = PackageJob::JobError::PackageCopyError;
+                return false;
+            }
+        }
+        if (!CopyEngine::exchangeTrees(stagedPath, targetName)) {
+            d->errorMessage = i18n("Impossible to remove the old installation of %1 located at %2. error: %3",
+                                   pluginName,
+                                   targetName,
+                                   i18n("Could not move package to destination: %1", targetName));
+            d->errorCode = PackageJob::JobError::OldVersionRemovalError;
+            return false;
+        }
+        // the old version is staged now, nobody looks at it anymore. In the trash it gets deleted
+        // even if this process doesn't live long enough to do it
+        stagingDir->setAutoRemove(false);
+        if (!PackageTrash::moveToTrash(stagingDir->path(), dest)) {
+            QThreadPool::globalInstance()->start([oldVersion = stagingDir->path()]() {
+                QDir(oldVersion).removeRecursively();
+            });
+        }
+    } else if (archivedPackage) {
+        // it's staged on the same filesystem, so just move it over.
+        const bool ok = CopyEngine::moveTree(path, targetName);
         if (!ok) {
             // qCWarning(KPACKAGE_LOG) << "Could not move package to destination:" << targetName;
             d->errorMessage = i18n("Could not move package to destination: %1", targetName);
@@ -327,7 +390,7 @@ bool PackageJobThread::installPackage(const QString &src, const QString &dest, c
     } else {
         // it's a directory containing the stuff, so copy the contents rather
         // than move them
-        const bool ok = copyFolder(path, targetName);
+        const bool ok = CopyEngine::copyTree(path, targetName);
         if (!ok) {
             // qCWarning(KPACKAGE_LOG) << "Could not copy package to destination:" << targetName;
             d->errorMessage = i18n("Could not copy package to destination: %1", targetName);
@@ -336,10 +399,8 @@ bool PackageJobThread::installPackage(const QString &src, const QString &dest, c
         }
     }
 
-    if (archivedPackage) {
-        // no need to remove the temp dir (which has been successfully moved if it's an archive)
-        tempdir.setAutoRemove(false);
-    }
+    // lets Package look files up without going to the disk, see PackageManifest
+    PackageManifest::write(targetName);
 
     d->installPath = targetName;
     return true;
@@ -348,6 +409,9 @@ bool PackageJobThread::installPackage(const QString &src, const QString &dest, c
 bool PackageJobThread::update(const QString &src, const QString &dest, const Package &package)
 {
     bool ok = installPackage(src, dest, package, PackageJob::Update);
+    if (ok && d->updateIndex) {
+        PackageIndex::update(dest);
+    }
     Q_EMIT installPathChanged(d->installPath);
     Q_EMIT jobThreadFinished(ok, errorCode(), d->errorMessage);
     return ok;
@@ -356,12 +420,53 @@ bool PackageJobThread::update(const QString &src, const QString &dest, const Pac
 bool PackageJobThread::uninstall(const QString &packagePath)
 {
     bool ok = uninstallPackage(packagePath);
+    if (ok && d->updateIndex) {
+        PackageIndex::update(QFileInfo(QDir::cleanPath(packagePath)).path());
+    }
     // Do not emit the install path changed, information about the removed package might be useful for consumers
     // qCDebug(KPACKAGE_LOG) << "Thread: installFinished" << ok;
     Q_EMIT jobThreadFinished(ok, errorCode(), d->errorMessage);
     return ok;
 }
 
+bool PackageJobThread::verify(const QString &packagePath, const QStringList &contentsPrefixPaths)
+{
+    qint64 totalBytes = 0;
+    qint64 reportedBytes = -1;
+    PackageHasher::Observer observer;
+    observer.started = [this, &totalBytes](qint64 bytes) {
+        totalBytes = bytes;
+        Q_EMIT hashingStarted(bytes);
+    };
+    observer.progressed = [this, &totalBytes, &reportedBytes](qint64 bytes) {
+        // about once per percent is plenty
+        if (bytes == totalBytes || reportedBytes < 0 || bytes - reportedBytes >= std::max<qint64>(totalBytes / 100, 1)) {
+            reportedBytes = bytes;
+            Q_EMIT bytesHashed(bytes);
+        }
+    };
+    observer.canceled = d->canceled.get();
+
+    // re-read in any case, files damaged without their modification time changing must not pass
+    const QByteArray hash = PackageHasher::hash(packagePath, contentsPrefixPaths, d->hashAlgorithm, observer, PackageHasher::BypassCache);
+    bool ok = false;
+    if (d->canceled && *d->canceled) {
+        // nobody is listening anymore
+        d->errorCode = KJob::KilledJobError;
+    } else if (hash.isEmpty()) {
+        d->errorMessage = i18n("Failed to generate a Package hash for %1", packagePath);
+        d->errorCode = PackageJob::JobError::PackageHashError;
+    } else if (!d->expectedHash.isEmpty() && hash != d->expectedHash.toLower()) {
+        d->errorMessage = i18n("The hash of the package at %1 is %2, %3 was expected", packagePath, QString::fromLatin1(hash), QString::fromLatin1(d->expectedHash));
+        d->errorCode = PackageJob::JobError::PackageHashMismatchError;
+    } else {
+        ok = true;
+    }
+    Q_EMIT hashComputed(hash);
+    Q_EMIT jobThreadFinished(ok, errorCode(), d->errorMessage);
+    return ok;
+}
+
 bool PackageJobThread::uninstallPackage(const QString &packagePath)
 {
     if (!QFile::exists(packagePath)) {
@@ -369,26 +474,18 @@ bool PackageJobThread::uninstallPackage(const QString &packagePath)
         d->errorCode = PackageJob::JobError::PackageFileNotFoundError;
         return false;
     }
-    QString pkg;
-    QString root;
-    {
-        // TODO KF6 remove, pass in packageroot, type and pluginName separately?
-        QStringList ps = packagePath.split(QLatin1Char('/'));
-        int ix = ps.count() - 1;
-        if (packagePath.endsWith(QLatin1Char('/'))) {
-            ix = ps.count() - 2;
-        }
-        pkg = ps[ix];
-        ps.pop_back();
-        root = ps.join(QLatin1Char('/'));
-    }
+    // the path of a Package ends with a slash
+    const QString root = QFileInfo(QDir::cleanPath(packagePath)).path();
 
-    bool ok = removeFolder(packagePath);
+    const QString canonicalPath = QFileInfo(packagePath).canonicalFilePath();
+    // out of the root at once, the files get deleted by the cleanup of the trash
+    bool ok = PackageTrash::moveToTrash(packagePath, root) || removeFolder(packagePath);
     if (!ok) {
         d->errorMessage = i18n("Could not delete package from: %1", packagePath);
         d->errorCode = PackageJob::JobError::PackageUninstallError;
         return false;
     }
+    PackageManifest::remove(canonicalPath);
 
     return true;
 }
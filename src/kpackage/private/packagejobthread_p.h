@@ -12,8 +12,12 @@
 #include "packagejob.h"
 #include <QRunnable>
 
+#include <atomic>
+#include <memory>
+
 namespace KPackage
 {
+class DependencyResolver;
 class PackageJobThreadPrivate;
 
 bool indexDirectory(const QString &dir, const QString &dest);
@@ -26,10 +30,17 @@ public:
     ~PackageJobThread() override;
 
     void run() override;
+    // whether the index of the package root gets updated once done, see PackageIndex. True by default
+    void setUpdateIndex(bool updateIndex);
+    // shares @p resolver with other jobs, dependencies get installed once for all of them
+    void setDependencyResolver(const std::shared_ptr<DependencyResolver> &resolver);
+    // what a verify job compares the package hash to, no comparison if @p expectedHash is empty
+    void setVerification(QCryptographicHash::Algorithm algorithm, const QByteArray &expectedHash, const std::shared_ptr<const std::atomic_bool> &canceled);
 
     bool install(const QString &src, const QString &dest, const Package &package);
     bool update(const QString &src, const QString &dest, const Package &package);
     bool uninstall(const QString &packagePath);
+    bool verify(const QString &packagePath, const QStringList &contentsPrefixPaths);
 
     PackageJob::JobError errorCode() const;
 
@@ -38,11 +49,17 @@ Q_SIGNALS:
     void percentChanged(int percent);
     void error(const QString &errorMessage);
     void installPathChanged(const QString &installPath);
+    void hashingStarted(qint64 totalBytes);
+    void bytesHashed(qint64 processedBytes);
+    void hashComputed(const QByteArray &hash);
 
 private:
     // OperationType says whether we want to install, update or any
     // new similar operation it will be expanded
-    bool installDependency(const QUrl &src);
+    // @return whether @p pluginId is safe to be used as the name of the package directory, setting the error otherwise
+    bool isValidPluginId(const QString &pluginId);
+    // @return whether the package @p pluginId may get installed to @p dest, setting the error otherwise
+    bool isInstallable(const QString &pluginId, const QString &dest, PackageJob::OperationType operation);
     bool installPackage(const QString &src, const QString &dest, const Package &package, PackageJob::OperationType operation);
     bool uninstallPackage(const QString &packagePath);
     PackageJobThreadPrivate *d;
@@ -0,0 +1,43 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "private/packagelistjobthread_p.h"
+#include "private/packageindex_p.h"
+#include "private/packageloader_p.h"
+
+#include <QSet>
+
+namespace KPackage
+{
+PackageListJobThread::PackageListJobThread(const QString &packageFormat, const QStringList &roots, const std::shared_ptr<std::atomic_bool> &canceled)
+    : QObject()
+    , QRunnable()
+    , m_packageFormat(packageFormat)
+    , m_roots(roots)
+    , m_canceled(canceled)
+{
+}
+
+PackageListJobThread::~PackageListJobThread() = default;
+
+void PackageListJobThread::run()
+{
+    QSet<QString> uniqueIds;
+    for (const QString &root : m_roots) {
+        if (*m_canceled) {
+            return;
+        }
+        const MetadataTable packages = PackageLoaderPrivate::mergeEntries(m_packageFormat, PackageIndex::entries(root), uniqueIds);
+        if (!packages.isEmpty()) {
+            Q_EMIT packagesFound(packages);
+        }
+    }
+    Q_EMIT listingFinished();
+}
+
+}
+
+#include "moc_packagelistjobthread_p.cpp"
@@ -0,0 +1,48 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPACKAGE_PACKAGELISTJOBTHREAD_P_H
+#define KPACKAGE_PACKAGELISTJOBTHREAD_P_H
+
+#include "private/metadatatable_p.h"
+
+#include <QObject>
+#include <QRunnable>
+#include <QStringList>
+
+#include <atomic>
+#include <memory>
+
+namespace KPackage
+{
+/**
+ * Lists package roots on a thread of the global thread pool on behalf of PackageListJob.
+ * The packages of each root are reported as soon as the root is read, in the order of the roots.
+ */
+class PackageListJobThread : public QObject, public QRunnable
+{
+    Q_OBJECT
+public:
+    explicit PackageListJobThread(const QString &packageFormat, const QStringList &roots, const std::shared_ptr<std::atomic_bool> &canceled);
+    ~PackageListJobThread() override;
+
+    void run() override;
+
+Q_SIGNALS:
+    // the rows keep the modification times of the metadata, for the listing cached by the loader
+    void packagesFound(const KPackage::MetadataTable &packages);
+    void listingFinished();
+
+private:
+    const QString m_packageFormat;
+    const QStringList m_roots;
+    // shared with the job, the job may be gone before this one is done
+    const std::shared_ptr<std::atomic_bool> m_canceled;
+};
+
+}
+
+#endif
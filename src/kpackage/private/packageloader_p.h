@@ -7,26 +7,110 @@
 #ifndef KPACKAGE_PACKAGELOADER_P_H
 #define KPACKAGE_PACKAGELOADER_P_H
 
+#include "packagequery.h"
 #include "packagestructure.h"
+#include "private/packageindex_p.h"
+#include "private/snapshot_p.h"
 #include <KPluginMetaData>
 #include <QHash>
+#include <QMutex>
 #include <QPointer>
+#include <QSet>
+
+#include <atomic>
+#include <memory>
+#include <optional>
 
 namespace KPackage
 {
+class PackageCacheNotifier;
+class PackageLoader;
+
 class PackageLoaderPrivate
 {
 public:
-    QHash<QString, QPointer<PackageStructure>> structures;
-    // We only use this cache during start of the process to speed up many consecutive calls
-    // After that, we're too afraid to produce race conditions and it's not that time-critical anyway
-    // the 20 seconds here means that the cache is only used within 20sec during startup, after that,
-    // complexity goes up and we'd have to update the cache in order to avoid subtle bugs
-    // just not using the cache is way easier then, since it doesn't make *that* much of a difference,
-    // anyway
-    int maxCacheAge = 20;
-    qint64 pluginCacheAge = 0;
-    QHash<QString, QList<KPluginMetaData>> pluginCache;
+    // Once published the listings are shared by all the threads and never modified,
+    // save for the caches of the lookups made on them
+    struct CachedListing {
+        // checks the roots every time, the metadata of the packages at most once per s_packagesCheckInterval
+        bool isUpToDate() const;
+        // @return all the packages, decoded the first time and then shared by all the callers
+        QList<KPluginMetaData> toList() const;
+        // @return the packages matching @p query, in listing order
+        QList<KPluginMetaData> query(const PackageQuery &query) const;
+        // builds the indexes the queries start from, done before the listing gets published
+        void buildIndex();
+        // @return the canonical path of the package with the given plugin id as cached by indexedPackagePath,
+        // std::nullopt if it wasn't looked up yet
+        std::optional<QString> canonicalPath(const QString &pluginId) const;
+        void cacheCanonicalPath(const QString &pluginId, const QString &path) const;
+
+        QString packageFormat;
+        // the package roots the listing was gathered from, cleaned with QDir::cleanPath
+        QStringList roots;
+        QList<qint64> rootModificationTimes;
+        MetadataTable packages;
+
+        // positions in packages
+        QHash<QString, QList<qsizetype>> pluginIds;
+        QHash<QString, QList<qsizetype>> categories;
+
+        // filled as the listing gets used, shared by the copies of the listing
+        struct Lookups {
+            QMutex mutex;
+            // indexed key by key, the first time a query uses the key
+            QHash<QString, QHash<QString, QList<qsizetype>>> values;
+            // plugin id to canonical package path, filled by the lookups of loadPackage
+            QHash<QString, QString> canonicalPaths;
+            // the result of toList
+            std::optional<QList<KPluginMetaData>> metadata;
+            // when isUpToDate last checked the metadata of the packages, on the steady clock in ms
+            std::atomic<qint64> packagesCheckedAt = 0;
+        };
+        std::shared_ptr<Lookups> lookups = std::make_shared<Lookups>();
+    };
+
+    // What the loader knows, readers get a consistent snapshot of it without locking
+    struct State {
+        QHash<QString, QPointer<PackageStructure>> structures;
+        // Listings stay cached until something tells us they are stale: a PackageJob of this process,
+        // the D-Bus notifications sent by the PackageJobs of other processes or one of its roots changing
+        QHash<QString, std::shared_ptr<const CachedListing>> pluginCache;
+    };
+
+    // @return a listing with the roots to look into for packages of @p packageFormat, but no packages yet
+    static CachedListing prepareListing(PackageLoader *loader, const QString &packageFormat, const QString &packageRoot);
+    static QString cacheKey(const QString &packageFormat, const QString &packageRoot);
+    // @return the directories to look into for packages installed under @p packageRoot
+    static QStringList packageRoots(const QString &packageRoot);
+    // @return the @p entries of the given format which aren't in @p uniqueIds yet, adding them to it
+    static MetadataTable mergeEntries(const QString &packageFormat, const MetadataTable &entries, QSet<QString> &uniqueIds);
+    static qint64 rootModificationTime(const QString &root);
+    // drops the listings that may contain packages of the given format
+    void invalidateFormat(const QString &packageFormat);
+    // drops the listings gathered from the given package root
+    void invalidateRoot(const QString &packageRoot);
+    // listens to the notifications of the PackageJobs of other processes
+    void setupNotifications();
+    // @return the cached listing for @p cacheKey if it is still up to date, stale ones are dropped
+    std::shared_ptr<const CachedListing> upToDateListing(const QString &cacheKey);
+    // @return the contents of each of the @p roots, read in parallel
+    static QHash<QString, MetadataTable> readRoots(const QStringList &roots);
+    // fills @p listing with the packages of its format out of the contents of its roots
+    static void mergeRoots(CachedListing &listing, const QHash<QString, MetadataTable> &entriesPerRoot);
+    // @return the up to date listing of the packages, gathered and cached if needed
+    std::shared_ptr<const CachedListing> listing(PackageLoader *loader, const QString &packageFormat, const QString &packageRoot);
+    // indexes @p listing and caches it for @p cacheKey
+    std::shared_ptr<const CachedListing> publishListing(const QString &cacheKey, CachedListing listing);
+    // @return the structure for @p packageFormat, @p structure unless another thread set one first, in which case
+    // @p structure gets deleted. A @p replace takes the place of the current structure instead.
+    PackageStructure *publishStructure(const QString &packageFormat, PackageStructure *structure, bool replace = false);
+    // @return the canonical path of the installed package @p pluginId according to the listing
+    // of @p packageFormat, empty if the listing can't tell
+    QString indexedPackagePath(PackageLoader *loader, const Package &package, const QString &packageFormat, const QString &pluginId);
+
+    SnapshotPointer<State> state;
+    PackageCacheNotifier *notifier = nullptr;
 };
 
 }
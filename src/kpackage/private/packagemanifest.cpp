@@ -0,0 +1,181 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "private/packagemanifest_p.h"
+
+#include "kpackage_debug.h"
+
+#include <QCborArray>
+#include <QCborMap>
+#include <QCborValue>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+
+namespace KPackage
+{
+static const int s_manifestVersion = 1;
+
+QString PackageManifest::manifestFilePath(const QString &packagePath)
+{
+    const QByteArray key = QCryptographicHash::hash(QDir::cleanPath(packagePath).toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QLatin1String("/kpackage/manifest/") + QString::fromLatin1(key);
+}
+
+bool PackageManifest::write(const QString &packagePath)
+{
+    const QString root = QFileInfo(packagePath).canonicalFilePath();
+    if (root.isEmpty()) {
+        return false;
+    }
+    const QString rootPrefix = root + QLatin1Char('/');
+
+    QList<std::pair<QString, quint8>> entries;
+    QCborArray directories{QCborArray{QString(), QFileInfo(root).lastModified().toMSecsSinceEpoch()}};
+    QDirIterator it(root, QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        // broken symlinks, sockets and the like are never found by Package anyway
+        if (!info.isFile() && !info.isDir()) {
+            continue;
+        }
+
+        const QString relativePath = info.filePath().mid(rootPrefix.size());
+        quint8 flags = 0;
+        if (info.isDir()) {
+            if (info.isSymLink()) {
+                qCDebug(KPACKAGE_LOG) << "Not writing a manifest for" << root << "it contains the symlinked directory" << relativePath;
+                remove(root);
+                return false;
+            }
+            directories.append(QCborArray{relativePath, info.lastModified().toMSecsSinceEpoch()});
+            flags |= Directory;
+        }
+        if (info.isReadable()) {
+            flags |= Readable;
+        }
+        if (info.canonicalFilePath().startsWith(rootPrefix)) {
+            flags |= InsidePackage;
+        }
+        entries.append({relativePath, flags});
+    }
+    std::sort(entries.begin(), entries.end());
+
+    QCborArray paths;
+    QByteArray flags;
+    flags.reserve(entries.size());
+    for (const auto &[path, entryFlags] : std::as_const(entries)) {
+        paths.append(path);
+        flags.append(char(entryFlags));
+    }
+    const QCborMap manifest{
+        {QLatin1String("version"), s_manifestVersion},
+        {QLatin1String("root"), root},
+        {QLatin1String("directories"), directories},
+        {QLatin1String("paths"), paths},
+        {QLatin1String("flags"), flags},
+    };
+
+    const QString manifestPath = manifestFilePath(root);
+    QDir().mkpath(QFileInfo(manifestPath).path());
+    QSaveFile file(manifestPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCDebug(KPACKAGE_LOG) << "Could not write package manifest" << manifestPath << file.errorString();
+        return false;
+    }
+    file.write(QCborValue(manifest).toCbor());
+    return file.commit();
+}
+
+void PackageManifest::remove(const QString &packagePath)
+{
+    QFile::remove(manifestFilePath(packagePath));
+}
+
+std::shared_ptr<const PackageManifest> PackageManifest::load(const QString &packagePath)
+{
+    QFile file(manifestFilePath(packagePath));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return nullptr;
+    }
+    const qint64 size = file.size();
+    uchar *data = size > 0 ? file.map(0, size) : nullptr;
+    if (!data) {
+        return nullptr;
+    }
+    const QCborMap manifest = QCborValue::fromCbor(QByteArray::fromRawData(reinterpret_cast<const char *>(data), size)).toMap();
+    file.unmap(data);
+
+    const QString root = QDir::cleanPath(packagePath);
+    if (manifest.value(QLatin1String("version")).toInteger() != s_manifestVersion || manifest.value(QLatin1String("root")).toString() != root) {
+        return nullptr;
+    }
+
+    // anything added, removed or renamed in the package shows in the time of its directory
+    const QCborArray directories = manifest.value(QLatin1String("directories")).toArray();
+    for (const QCborValue &value : directories) {
+        const QCborArray directory = value.toArray();
+        const QString relativePath = directory.at(0).toString();
+        const QFileInfo info(relativePath.isEmpty() ? root : root + QLatin1Char('/') + relativePath);
+        if (!info.isDir() || info.lastModified().toMSecsSinceEpoch() != directory.at(1).toInteger()) {
+            return nullptr;
+        }
+    }
+
+    const QCborArray paths = manifest.value(QLatin1String("paths")).toArray();
+    const QByteArray flags = manifest.value(QLatin1String("flags")).toByteArray();
+    if (paths.size() != flags.size()) {
+        return nullptr;
+    }
+
+    auto result = std::make_shared<PackageManifest>();
+    result->m_paths.reserve(paths.size());
+    result->m_flags.reserve(flags.size());
+    for (qsizetype i = 0; i < paths.size(); ++i) {
+        result->m_paths << paths.at(i).toString();
+        result->m_flags << quint8(flags.at(i));
+    }
+    return result;
+}
+
+int PackageManifest::flags(const QString &relativePath) const
+{
+    const auto it = std::lower_bound(m_paths.cbegin(), m_paths.cend(), relativePath);
+    if (it == m_paths.cend() || *it != relativePath) {
+        return -1;
+    }
+    return m_flags.at(std::distance(m_paths.cbegin(), it));
+}
+
+QStringList PackageManifest::readableFiles(const QString &relativeDirectory) const
+{
+    const QString prefix = relativeDirectory + QLatin1Char('/');
+    QStringList files;
+    for (auto it = std::lower_bound(m_paths.cbegin(), m_paths.cend(), prefix); it != m_paths.cend() && it->startsWith(prefix); ++it) {
+        const QString name = it->mid(prefix.size());
+        const quint8 entryFlags = m_flags.at(std::distance(m_paths.cbegin(), it));
+        // like QDir::Files | QDir::Readable: no hidden files and nothing from the subdirectories
+        if (name.contains(QLatin1Char('/')) || name.startsWith(QLatin1Char('.')) || (entryFlags & Directory) || !(entryFlags & Readable)) {
+            continue;
+        }
+        files << name;
+    }
+    // the default sorting of QDir
+    std::stable_sort(files.begin(), files.end(), [](const QString &left, const QString &right) {
+        return left.compare(right, Qt::CaseInsensitive) < 0;
+    });
+    return files;
+}
+
+}
@@ -0,0 +1,66 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPACKAGE_PACKAGEMANIFEST_P_H
+#define KPACKAGE_PACKAGEMANIFEST_P_H
+
+#include <QList>
+#include <QStringList>
+
+#include <memory>
+
+namespace KPackage
+{
+/**
+ * Sorted table of everything an installed package contains, written by PackageJob at install time.
+ *
+ * With it Package answers filePath, entryList and isValid with binary searches instead of a
+ * stat and a canonicalization per lookup. It records the modification time of every directory of
+ * the package, a manifest is only used as long as none of them changed. Packages containing
+ * symlinked directories get no manifest, their contents can't be known without following them.
+ */
+class PackageManifest
+{
+public:
+    enum Flag : quint8 {
+        Directory = 0x1,
+        /// the canonical path of the entry is inside the package
+        InsidePackage = 0x2,
+        Readable = 0x4,
+    };
+
+    /**
+     * Records the contents of the package installed in @p packagePath
+     */
+    static bool write(const QString &packagePath);
+    static void remove(const QString &packagePath);
+
+    /**
+     * @return the manifest of the package in @p packagePath, nullptr if there is none or if it is outdated
+     */
+    static std::shared_ptr<const PackageManifest> load(const QString &packagePath);
+
+    /**
+     * @return the flags of @p relativePath, -1 if the package does not contain it
+     */
+    int flags(const QString &relativePath) const;
+
+    /**
+     * @return the names of the readable files directly inside @p relativeDirectory, sorted like QDir::entryList does
+     */
+    QStringList readableFiles(const QString &relativeDirectory) const;
+
+private:
+    static QString manifestFilePath(const QString &packagePath);
+
+    // relative to the package, sorted, without trailing slashes
+    QStringList m_paths;
+    QList<quint8> m_flags;
+};
+
+}
+
+#endif
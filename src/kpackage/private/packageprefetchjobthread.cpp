@@ -0,0 +1,41 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "private/packageprefetchjobthread_p.h"
+#include "private/package_p.h"
+#include "private/parallel_p.h"
+
+namespace KPackage
+{
+PackagePrefetchJobThread::PackagePrefetchJobThread(const std::shared_ptr<QList<Package>> &packages,
+                                                   const QList<QByteArray> &fileTypes,
+                                                   const std::shared_ptr<std::atomic_bool> &canceled)
+    : QObject()
+    , QRunnable()
+    , m_packages(packages)
+    , m_fileTypes(fileTypes)
+    , m_canceled(canceled)
+{
+}
+
+PackagePrefetchJobThread::~PackagePrefetchJobThread() = default;
+
+void PackagePrefetchJobThread::run()
+{
+    Package *packages = m_packages->data();
+    parallelFor(m_packages->size(), [this, packages](qsizetype i) {
+        if (!*m_canceled) {
+            PackagePrivate::prefetch(packages[i], m_fileTypes);
+        }
+    });
+    if (!*m_canceled) {
+        Q_EMIT prefetchFinished();
+    }
+}
+
+}
+
+#include "moc_packageprefetchjobthread_p.cpp"
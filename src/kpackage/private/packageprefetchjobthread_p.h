@@ -0,0 +1,48 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPACKAGE_PACKAGEPREFETCHJOBTHREAD_P_H
+#define KPACKAGE_PACKAGEPREFETCHJOBTHREAD_P_H
+
+#include "../package.h"
+
+#include <QObject>
+#include <QRunnable>
+
+#include <atomic>
+#include <memory>
+
+namespace KPackage
+{
+/**
+ * Looks up the files of packages on a thread of the global thread pool on behalf of PackagePrefetchJob.
+ * The packages are copies nothing else uses, see PackagePrivate::detachedCopy, they are looked into in parallel.
+ */
+class PackagePrefetchJobThread : public QObject, public QRunnable
+{
+    Q_OBJECT
+public:
+    explicit PackagePrefetchJobThread(const std::shared_ptr<QList<Package>> &packages,
+                                      const QList<QByteArray> &fileTypes,
+                                      const std::shared_ptr<std::atomic_bool> &canceled);
+    ~PackagePrefetchJobThread() override;
+
+    void run() override;
+
+Q_SIGNALS:
+    void prefetchFinished();
+
+private:
+    // shared with the job, which only reads them once prefetchFinished got emitted
+    const std::shared_ptr<QList<Package>> m_packages;
+    const QList<QByteArray> m_fileTypes;
+    // shared with the job, the job may be gone before this one is done
+    const std::shared_ptr<std::atomic_bool> m_canceled;
+};
+
+}
+
+#endif
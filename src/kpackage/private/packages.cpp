@@ -12,6 +12,12 @@
 
 #include "kpackage/package.h"
 
+GenericPackage::GenericPackage()
+{
+    // the definitions are the same for every package
+    setPackageTemplateEnabled(true);
+}
+
 void GenericPackage::initPackage(KPackage::Package *package)
 {
     KPackage::PackageStructure::initPackage(package);
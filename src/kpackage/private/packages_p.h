@@ -12,6 +12,7 @@ class GenericPackage : public KPackage::PackageStructure
 {
     Q_OBJECT
 public:
+    GenericPackage();
     void initPackage(KPackage::Package *package) override;
 };
 
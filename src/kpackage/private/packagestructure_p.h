@@ -0,0 +1,45 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPACKAGE_PACKAGESTRUCTURE_P_H
+#define KPACKAGE_PACKAGESTRUCTURE_P_H
+
+#include "../packagestructure.h"
+#include "package_p.h"
+
+#include <QMutex>
+
+namespace KPackage
+{
+class PackageStructurePrivate
+{
+public:
+    static PackageStructurePrivate *get(const PackageStructure *structure)
+    {
+        return static_cast<PackageStructurePrivate *>(structure->d);
+    }
+
+    /**
+     * @return the state of a package fresh out of initPackage. It is built once and then
+     * copied into every new Package of the structure, it must not be modified.
+     * Null unless the structure enabled its template.
+     */
+    QExplicitlySharedDataPointer<PackagePrivate> packageTemplate(PackageStructure *structure);
+    void setPackageTemplateEnabled(bool enabled);
+    void invalidatePackageTemplate();
+
+private:
+    // packages get created from the threads of PackageJob as well
+    QMutex mutex;
+    bool templateEnabled = false;
+    QExplicitlySharedDataPointer<PackagePrivate> m_packageTemplate;
+    // bumped whenever the template gets dropped, a template built meanwhile is outdated already
+    quint64 generation = 0;
+};
+
+}
+
+#endif
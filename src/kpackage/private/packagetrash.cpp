@@ -0,0 +1,91 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "private/packagetrash_p.h"
+
+#include "kpackage_debug.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QThreadPool>
+
+namespace KPackage
+{
+// in seconds, moving a package into its slot takes a rename, an install rarely takes more than a few seconds
+static constexpr qint64 s_abandonedSlotAge = 60 * 60;
+
+static void removeDirectory(const QDir &parent, const QString &entry)
+{
+    if (!QDir(parent.filePath(entry)).removeRecursively()) {
+        qCDebug(KPACKAGE_LOG) << "Could not delete" << entry << "from" << parent.path();
+    }
+}
+
+QString PackageTrash::trashPath(const QString &packageRoot)
+{
+    return QDir::cleanPath(packageRoot) + QLatin1String("/.kpackage-trash");
+}
+
+bool PackageTrash::moveToTrash(const QString &path, const QString &packageRoot)
+{
+    const QString trash = trashPath(packageRoot);
+    if (!QDir().mkpath(trash)) {
+        return false;
+    }
+    // a directory of its own, so that removing a package again under the same name can't collide
+    QTemporaryDir slot(trash + QLatin1Char('/') + QFileInfo(QDir::cleanPath(path)).fileName() + QLatin1String("-XXXXXX"));
+    if (!slot.isValid()) {
+        return false;
+    }
+    // the trash is inside the root, it's a rename on the same filesystem
+    if (!QDir().rename(QDir::cleanPath(path), slot.filePath(QStringLiteral("package")))) {
+        qCDebug(KPACKAGE_LOG) << "Could not move" << path << "into the trash at" << trash;
+        return false;
+    }
+    slot.setAutoRemove(false);
+    scheduleCleanup(packageRoot);
+    return true;
+}
+
+void PackageTrash::scheduleCleanup(const QString &packageRoot)
+{
+    const QString root = QDir::cleanPath(packageRoot);
+    if (!QFileInfo::exists(root)) {
+        return;
+    }
+    QThreadPool::globalInstance()->start([root]() {
+        // the pool threads are shared, the priority goes back to what it was
+        QThread *thread = QThread::currentThread();
+        const QThread::Priority priority = thread->priority();
+        thread->setPriority(QThread::IdlePriority);
+        // the trash itself stays, another job may be moving a package into it right now: a slot which
+        // got no package yet is only deleted once it is too old to still be waiting for one
+        const QDateTime abandoned = QDateTime::currentDateTime().addSecs(-s_abandonedSlotAge);
+        const QDir trash(trashPath(root));
+        const QStringList entries = trash.entryList(QDir::Dirs | QDir::Hidden | QDir::NoDotAndDotDot);
+        for (const QString &entry : entries) {
+            const QString slot = trash.filePath(entry);
+            if (QFileInfo::exists(slot + QLatin1String("/package")) || QFileInfo(slot).lastModified() <= abandoned) {
+                removeDirectory(trash, entry);
+            }
+        }
+        // the staging directories of installs get their package before it gets copied or extracted,
+        // only their age tells the ones of crashed installs apart
+        const QDir rootDir(root);
+        const QStringList stagingDirs = rootDir.entryList({QStringLiteral(".kpackage-install-*")}, QDir::Dirs | QDir::Hidden | QDir::NoDotAndDotDot);
+        for (const QString &stagingDir : stagingDirs) {
+            if (QFileInfo(rootDir.filePath(stagingDir)).lastModified() <= abandoned) {
+                removeDirectory(rootDir, stagingDir);
+            }
+        }
+        thread->setPriority(priority);
+    });
+}
+
+}
@@ -0,0 +1,48 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPACKAGE_PACKAGETRASH_P_H
+#define KPACKAGE_PACKAGETRASH_P_H
+
+#include <QString>
+
+namespace KPackage
+{
+/**
+ * Where removed packages wait to be deleted.
+ *
+ * Every package root gets a hidden .kpackage-trash directory. Uninstalling a package, or replacing it
+ * with a new version, renames it in there, which is atomic and costs the same however big the package is.
+ * The job is then done, and the contents of the trash get deleted on a low priority thread of the pool.
+ * Whatever a crashed process left in the trash goes away with the next cleanup of that root, as do the
+ * .kpackage-install-* staging directories of installs which didn't finish within an hour.
+ *
+ * Hidden directories are no packages to the listings, see PackageIndex, nothing looks into the trash.
+ */
+class PackageTrash
+{
+public:
+    /**
+     * Moves @p path out of the package root @p packageRoot into its trash, and schedules the cleanup of the trash.
+     * @return false if @p path couldn't be renamed, it is left in place then
+     */
+    static bool moveToTrash(const QString &path, const QString &packageRoot);
+
+    /**
+     * Deletes the contents of the trash of @p packageRoot and the abandoned staging directories of installs
+     * on a low priority thread of the global thread pool.
+     */
+    static void scheduleCleanup(const QString &packageRoot);
+
+    /**
+     * @return the location of the trash of @p packageRoot
+     */
+    static QString trashPath(const QString &packageRoot);
+};
+
+}
+
+#endif
@@ -0,0 +1,57 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPACKAGE_PARALLEL_P_H
+#define KPACKAGE_PARALLEL_P_H
+
+#include <QSemaphore>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <atomic>
+
+namespace KPackage
+{
+/**
+ * Calls @p function for every index in [0, count), spread over the calling thread and the
+ * idle threads of the global thread pool, the one PackageJob runs on.
+ * Helpers are only started on threads which are free right away and the calling thread takes
+ * its share of the work, so this can't dead-lock even when called from a pool thread.
+ * Returns once all the calls are done.
+ */
+template<typename Function>
+void parallelFor(qsizetype count, const Function &function)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    std::atomic<qsizetype> next = 0;
+    auto work = [&next, count, &function]() {
+        for (qsizetype i = next++; i < count; i = next++) {
+            function(i);
+        }
+    };
+
+    QSemaphore finishedHelpers;
+    int helpers = 0;
+    QThreadPool *pool = QThreadPool::globalInstance();
+    const qsizetype wantedHelpers = std::min<qsizetype>(count - 1, pool->maxThreadCount());
+    while (helpers < wantedHelpers
+           && pool->tryStart([&work, &finishedHelpers]() {
+                  work();
+                  finishedHelpers.release();
+              })) {
+        ++helpers;
+    }
+
+    work();
+    finishedHelpers.acquire(helpers);
+}
+
+}
+
+#endif
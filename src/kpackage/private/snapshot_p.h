@@ -0,0 +1,79 @@
+/*
+    SPDX-FileCopyrightText: 2026 KPackage contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPACKAGE_SNAPSHOT_P_H
+#define KPACKAGE_SNAPSHOT_P_H
+
+#include <QMutex>
+
+#include <atomic>
+#include <memory>
+
+namespace KPackage
+{
+/**
+ * Holds an immutable T which readers on any thread get a snapshot of, and writers replace
+ * as a whole with an updated copy.
+ *
+ * Every thread keeps the last snapshot it got, along with its generation: as long as nothing
+ * got published in between, reading costs one atomic load. Only the first read after an update
+ * takes the mutex, to pick up the new snapshot. Writers are serialized by that same mutex.
+ * Old snapshots are freed once the last thread holding them has moved on to a newer one.
+ */
+template<typename T>
+class SnapshotPointer
+{
+public:
+    SnapshotPointer()
+        : m_current(std::make_shared<const T>())
+        , m_generation(nextGeneration())
+    {
+    }
+
+    std::shared_ptr<const T> load() const
+    {
+        // the generations are unique across all the instances, so one cache per thread is enough
+        thread_local std::shared_ptr<const T> cached;
+        thread_local quint64 cachedGeneration = 0;
+        if (cachedGeneration != m_generation.load(std::memory_order_acquire)) {
+            QMutexLocker locker(&m_mutex);
+            cached = m_current;
+            cachedGeneration = m_generation.load(std::memory_order_relaxed);
+        }
+        return cached;
+    }
+
+    /**
+     * Publishes a copy of the current T after calling @p update on it.
+     * @p update returns false if it has nothing to change, nothing gets published then.
+     */
+    template<typename Function>
+    void update(const Function &update)
+    {
+        QMutexLocker locker(&m_mutex);
+        auto next = std::make_shared<T>(*m_current);
+        if (!update(*next)) {
+            return;
+        }
+        m_current = std::move(next);
+        m_generation.store(nextGeneration(), std::memory_order_release);
+    }
+
+private:
+    static quint64 nextGeneration()
+    {
+        static std::atomic<quint64> s_generation = 0;
+        return ++s_generation;
+    }
+
+    mutable QMutex m_mutex;
+    std::shared_ptr<const T> m_current;
+    std::atomic<quint64> m_generation;
+};
+
+}
+
+#endif
@@ -6,6 +6,8 @@
 
 #include "kpackage_debug.h"
 #include <KPluginMetaData>
+#include <QHash>
+#include <QMutex>
 #include <QString>
 #include <QVersionNumber>
 
@@ -14,20 +16,44 @@ inline QString readKPackageType(const KPluginMetaData &metaData)
     return metaData.value(QStringLiteral("KPackageStructure"));
 }
 
+// All the package structure plugins, looked up once per process
+inline QList<KPluginMetaData> packageStructurePlugins()
+{
+    static const QList<KPluginMetaData> plugins = KPluginMetaData::findPlugins(QStringLiteral("kf6/packagestructure"));
+    return plugins;
+}
+
 inline KPluginMetaData structureForKPackageType(const QString &packageFormat)
 {
+    // Formats are resolved once per process, the ones without a plugin included.
+    // Loading a package structure is then a hash lookup, however often it is asked for
+    static QMutex mutex;
+    static QHash<QString, KPluginMetaData> resolved;
+    QMutexLocker locker(&mutex);
+    if (auto it = resolved.constFind(packageFormat); it != resolved.cend()) {
+        return it.value();
+    }
+
     const QString guessedPath = QStringLiteral("kf6/packagestructure/") + QString(packageFormat).toLower().replace(QLatin1Char('/'), QLatin1Char('_'));
     KPluginMetaData guessedData(guessedPath);
     if (guessedData.isValid() && readKPackageType(guessedData) == packageFormat) {
+        resolved.insert(packageFormat, guessedData);
         return guessedData;
     }
     qCDebug(KPACKAGE_LOG) << "Could not find package structure for" << packageFormat << "by plugin path. The guessed path was" << guessedPath;
 
-    const QList<KPluginMetaData> plugins =
-        KPluginMetaData::findPlugins(QStringLiteral("kf6/packagestructure"), [packageFormat](const KPluginMetaData &metaData) {
-            return readKPackageType(metaData) == packageFormat;
-        });
-    return plugins.isEmpty() ? KPluginMetaData() : plugins.first();
+    // only the format asked for gets cached, the guessed path of any other one still comes first
+    KPluginMetaData result;
+    const QList<KPluginMetaData> plugins = packageStructurePlugins();
+    for (const KPluginMetaData &metaData : plugins) {
+        // the first plugin of a format wins, as with findPlugins
+        if (readKPackageType(metaData) == packageFormat) {
+            result = metaData;
+            break;
+        }
+    }
+    resolved.insert(packageFormat, result);
+    return result;
 }
 
 inline bool isVersionNewer(const QString &version1, const QString &version2)
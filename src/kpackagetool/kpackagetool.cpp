@@ -21,6 +21,9 @@
 #include <QCommandLineParser>
 #include <QDir>
 #include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QList>
 #include <QMap>
 #include <QRegularExpression>
@@ -32,6 +35,7 @@
 
 #include <iomanip>
 #include <iostream>
+#include <memory>
 
 #include "options.h"
 
@@ -57,6 +61,7 @@ public:
     QStringList packages(const QString &type, const QString &path = QString());
     void renderTypeTable(const QMap<QString, QString> &plugins);
     void listTypes();
+    void listTypesAsJson(const QList<KPluginMetaData> &offers);
     void coutput(const QString &msg);
     void cerror(const QString &msg);
     QCommandLineParser *parser = nullptr;
@@ -78,17 +83,34 @@ PackageTool::~PackageTool()
 void PackageTool::runMain()
 {
     if (d->parser->isSet(Options::hash())) {
-        const QString path = d->parser->value(Options::hash());
-        KPackage::PackageStructure structure;
-        KPackage::Package package(&structure);
-        package.setPath(path);
-        const QString hash = QString::fromLocal8Bit(package.cryptographicHash(QCryptographicHash::Sha1));
-        if (hash.isEmpty()) {
-            d->coutput(i18n("Failed to generate a Package hash for %1", path));
-            exit(9);
-        } else {
-            d->coutput(i18n("SHA1 hash for Package at %1: '%2'", package.path(), hash));
-            exit(0);
+        // several packages can be given, they get hashed concurrently and reported in order
+        const QStringList paths = d->parser->values(Options::hash());
+        auto structure = new KPackage::PackageStructure(this);
+        auto jobs = std::make_shared<QList<KPackage::PackageJob *>>();
+        auto remaining = std::make_shared<int>(paths.size());
+        for (const QString &path : paths) {
+            KPackage::Package package(structure);
+            package.setPath(path);
+            auto job = KPackage::PackageJob::verify(package);
+            job->setAutoDelete(false);
+            jobs->append(job);
+            connect(job, &KJob::finished, this, [this, paths, jobs, remaining]() {
+                if (--*remaining > 0) {
+                    return;
+                }
+                int exitcode = 0;
+                for (int i = 0; i < jobs->size(); ++i) {
+                    KPackage::PackageJob *job = jobs->at(i);
+                    if (job->error() != KJob::NoError) {
+                        d->coutput(i18n("Failed to generate a Package hash for %1", paths.at(i)));
+                        exitcode = 9;
+                    } else {
+                        d->coutput(i18n("SHA1 hash for Package at %1: '%2'", job->package().path(), QString::fromLatin1(job->hash())));
+                    }
+                    job->deleteLater();
+                }
+                exit(exitcode);
+            });
         }
         return;
     }
@@ -130,6 +152,45 @@ void PackageTool::runMain()
         qWarning() << "Package type" << d->kpackageType << "not found";
     }
 
+    if (d->parser->isSet(Options::generateIndex()) || d->parser->isSet(Options::removeIndex())) {
+        const QString packageRoot = QDir::cleanPath(resolvePackageRootWithOptions());
+        if (d->parser->isSet(Options::generateIndex())) {
+            if (!KPackage::PackageLoader::generateSharedIndex(packageRoot)) {
+                d->cerror(i18n("Error: Could not generate the package index of %1", packageRoot));
+                exit(1);
+                return;
+            }
+            d->coutput(i18n("Generated the package index of %1", packageRoot));
+        } else if (!KPackage::PackageLoader::removeSharedIndex(packageRoot)) {
+            d->cerror(i18n("Error: There is no package index of %1 to remove", packageRoot));
+            exit(1);
+            return;
+        } else {
+            d->coutput(i18n("Removed the package index of %1", packageRoot));
+        }
+        exit(0);
+        return;
+    }
+
+    if (d->parser->isSet(Options::installMany())) {
+        d->packageRoot = resolvePackageRootWithOptions();
+        QStringList packageFiles;
+        const QStringList arguments = d->parser->positionalArguments();
+        for (const QString &argument : arguments) {
+            packageFiles << QFileInfo(argument).absoluteFilePath();
+        }
+        if (packageFiles.isEmpty()) {
+            d->cerror(i18n("Error: No packages given to install."));
+            exit(6);
+            return;
+        }
+        auto installJob = KPackage::PackageBatchJob::install(d->kpackageType, packageFiles, d->packageRoot);
+        connect(installJob, &KPackage::PackageBatchJob::finished, this, [installJob, this]() {
+            packagesInstalled(installJob);
+        });
+        return;
+    }
+
     if (d->parser->isSet(Options::show())) {
         const QString pluginName = d->package;
         showPackageInfo(pluginName);
@@ -141,9 +202,9 @@ void PackageTool::runMain()
     }
 
     if (d->parser->isSet(Options::list())) {
-        QString packageRoot = resolvePackageRootWithOptions();
-        d->coutput(i18n("Listing KPackageType: %1 in %2", d->kpackageType, packageRoot));
-        listPackages(d->kpackageType, packageRoot);
+        // without -t the default type gets listed, as before
+        const QStringList types = d->parser->values(Options::type());
+        listPackages(types.isEmpty() ? QStringList(d->kpackageType) : types);
         exit(0);
     } else {
         // install, remove or upgrade
@@ -442,14 +503,58 @@ QString PackageTool::resolvePackageRootWithOptions()
     return packageRoot;
 }
 
-void PackageTool::listPackages(const QString &kpackageType, const QString &path)
+static QJsonObject packageToJson(const KPluginMetaData &metadata)
 {
-    QStringList list = d->packages(kpackageType, path);
-    list.sort();
-    for (const QString &package : std::as_const(list)) {
-        d->coutput(package);
+    return QJsonObject{
+        {QStringLiteral("id"), metadata.pluginId()},
+        {QStringLiteral("name"), metadata.name()},
+        {QStringLiteral("version"), metadata.version()},
+        {QStringLiteral("path"), QFileInfo(metadata.fileName()).path()},
+    };
+}
+
+void PackageTool::listPackages(const QStringList &kpackageTypes)
+{
+    // the types are grouped by package root, each group gets listed in one go
+    QMap<QString, QStringList> typesPerRoot;
+    QHash<QString, QString> roots;
+    for (const QString &kpackageType : kpackageTypes) {
+        d->packageRoot = KPackage::PackageLoader::self()->loadPackage(kpackageType).defaultPackageRoot();
+        const QString packageRoot = resolvePackageRootWithOptions();
+        typesPerRoot[packageRoot] << kpackageType;
+        roots.insert(kpackageType, packageRoot);
+    }
+    QHash<QString, QList<KPluginMetaData>> packages;
+    for (auto it = typesPerRoot.cbegin(); it != typesPerRoot.cend(); ++it) {
+        packages.insert(KPackage::PackageLoader::self()->listPackagesByFormat(it.value(), it.key()));
+    }
+
+    if (d->parser->isSet(Options::json())) {
+        QJsonObject result;
+        for (const QString &kpackageType : kpackageTypes) {
+            QJsonArray list;
+            for (const KPluginMetaData &metadata : packages.value(kpackageType)) {
+                list << packageToJson(metadata);
+            }
+            result.insert(kpackageType, QJsonObject{{QStringLiteral("root"), roots.value(kpackageType)}, {QStringLiteral("packages"), list}});
+        }
+        d->coutput(QString::fromUtf8(QJsonDocument(result).toJson()));
+        return;
+    }
+
+    for (const QString &kpackageType : kpackageTypes) {
+        d->coutput(i18n("Listing KPackageType: %1 in %2", kpackageType, roots.value(kpackageType)));
+        QStringList list;
+        for (const KPluginMetaData &metadata : packages.value(kpackageType)) {
+            if (!list.contains(metadata.pluginId())) {
+                list << metadata.pluginId();
+            }
+        }
+        list.sort();
+        for (const QString &package : std::as_const(list)) {
+            d->coutput(package);
+        }
     }
-    exit(0);
 }
 
 void PackageToolPrivate::renderTypeTable(const QMap<QString, QString> &plugins)
@@ -486,6 +591,12 @@ void PackageToolPrivate::renderTypeTable(const QMap<QString, QString> &plugins)
 
 void PackageToolPrivate::listTypes()
 {
+    const QList<KPluginMetaData> offers = packageStructurePlugins();
+    if (parser->isSet(Options::json())) {
+        listTypesAsJson(offers);
+        return;
+    }
+
     coutput(i18n("Package types that are installable with this tool:"));
     coutput(i18n("Built in:"));
 
@@ -495,8 +606,6 @@ void PackageToolPrivate::listTypes()
 
     renderTypeTable(builtIns);
 
-    const QList<KPluginMetaData> offers = KPluginMetaData::findPlugins(QStringLiteral("kf6/packagestructure"));
-
     if (!offers.isEmpty()) {
         std::cout << std::endl;
         coutput(i18n("Provided by plugins:"));
@@ -515,6 +624,39 @@ void PackageToolPrivate::listTypes()
     }
 }
 
+void PackageToolPrivate::listTypesAsJson(const QList<KPluginMetaData> &offers)
+{
+    QStringList types{QStringLiteral("KPackage/Generic"), QStringLiteral("KPackage/GenericQML")};
+    QHash<QString, QString> plugins;
+    for (const KPluginMetaData &info : offers) {
+        const QString type = readKPackageType(info);
+        if (!type.isEmpty() && !plugins.contains(type) && !types.contains(type)) {
+            types << type;
+            plugins.insert(type, info.fileName());
+        }
+    }
+
+    // the packages installed everywhere, all the types in a single pass over the package roots
+    const QHash<QString, QList<KPluginMetaData>> installed = KPackage::PackageLoader::self()->listPackagesByFormat(types);
+    QJsonArray result;
+    for (const QString &type : std::as_const(types)) {
+        QJsonArray packages;
+        for (const KPluginMetaData &metadata : installed.value(type)) {
+            packages << packageToJson(metadata);
+        }
+        QJsonObject entry{
+            {QStringLiteral("type"), type},
+            {QStringLiteral("root"), KPackage::PackageLoader::self()->loadPackage(type).defaultPackageRoot()},
+            {QStringLiteral("packages"), packages},
+        };
+        if (plugins.contains(type)) {
+            entry.insert(QStringLiteral("plugin"), plugins.value(type));
+        }
+        result << entry;
+    }
+    coutput(QString::fromUtf8(QJsonDocument(result).toJson()));
+}
+
 void PackageTool::packageInstalled(KPackage::PackageJob *job)
 {
     bool success = (job->error() == KJob::NoError);
@@ -532,6 +674,24 @@ void PackageTool::packageInstalled(KPackage::PackageJob *job)
     exit(exitcode);
 }
 
+void PackageTool::packagesInstalled(KPackage::PackageBatchJob *job)
+{
+    int exitcode = 0;
+    if (job->count() == 0 && job->error() != KJob::NoError) {
+        d->cerror(i18n("Error: Installation failed: %1", job->errorText()));
+        exitcode = 4;
+    }
+    for (int i = 0; i < job->count(); ++i) {
+        if (job->packageError(i) == KJob::NoError) {
+            d->coutput(i18n("Successfully installed %1", job->package(i).path()));
+        } else {
+            d->cerror(i18n("Error: Installation of %1 failed: %2", job->source(i), job->packageErrorText(i)));
+            exitcode = 4;
+        }
+    }
+    exit(exitcode);
+}
+
 void PackageTool::packageUninstalled(KPackage::PackageJob *job)
 {
     bool success = (job->error() == KJob::NoError);
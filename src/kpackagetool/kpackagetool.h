@@ -9,6 +9,7 @@
 #define PACKAGETOOL_H
 
 #include "package.h"
+#include "packagebatchjob.h"
 #include "packagejob.h"
 #include <QCoreApplication>
 
@@ -27,7 +28,8 @@ public:
     PackageTool(int &argc, char **argv, QCommandLineParser *parser);
     ~PackageTool() override;
 
-    void listPackages(const QString &kpackageType, const QString &path = QString());
+    // lists the packages of all the types at once
+    void listPackages(const QStringList &kpackageTypes);
     void showPackageInfo(const QString &pluginName);
     void showAppstreamInfo(const QString &pluginName);
     QString resolvePackageRootWithOptions();
@@ -35,6 +37,7 @@ public:
 private Q_SLOTS:
     void runMain();
     void packageInstalled(KPackage::PackageJob *job);
+    void packagesInstalled(KPackage::PackageBatchJob *job);
     void packageUninstalled(KPackage::PackageJob *job);
 
 private:
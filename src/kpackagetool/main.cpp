@@ -44,18 +44,24 @@ int main(int argc, char **argv)
                        Options::global(),
                        Options::type(),
                        Options::install(),
+                       Options::installMany(),
                        Options::show(),
                        Options::upgrade(),
                        Options::list(),
                        Options::listTypes(),
+                       Options::json(),
                        Options::remove(),
+                       Options::generateIndex(),
+                       Options::removeIndex(),
                        Options::packageRoot(),
                        Options::appstream(),
                        Options::appstreamOutput()});
+    parser.addPositionalArgument(QStringLiteral("path"), i18n("Packages to install with --install-many"), QStringLiteral("[path...]"));
     parser.process(app);
 
     // at least one operation should be specified
-    if (!parser.isSet(QStringLiteral("hash")) && !parser.isSet(QStringLiteral("g")) && !parser.isSet(QStringLiteral("i")) && !parser.isSet(QStringLiteral("s"))
+    if (!parser.isSet(QStringLiteral("hash")) && !parser.isSet(QStringLiteral("g")) && !parser.isSet(QStringLiteral("i"))
+        && !parser.isSet(QStringLiteral("install-many")) && !parser.isSet(QStringLiteral("s"))
         && !parser.isSet(QStringLiteral("appstream-metainfo")) && !parser.isSet(QStringLiteral("u")) && !parser.isSet(QStringLiteral("l"))
         && !parser.isSet(QStringLiteral("list-types")) && !parser.isSet(QStringLiteral("r")) && !parser.isSet(QStringLiteral("generate-index"))
         && !parser.isSet(QStringLiteral("remove-index"))) {
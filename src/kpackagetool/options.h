@@ -8,7 +8,7 @@ namespace Options
 static QCommandLineOption hash()
 {
     static QCommandLineOption o{QStringLiteral("hash"),
-                                i18nc("Do not translate <path>", "Generate a SHA1 hash for the package at <path>"),
+                                i18nc("Do not translate <path>", "Generate a SHA1 hash for the package at <path>, can be given several times"),
                                 QStringLiteral("path")};
     return o;
 }
@@ -25,7 +25,7 @@ static QCommandLineOption type()
                                       "are recognized by the application "
                                       "(if translated, should be same as messages with 'package type' context below)",
                                       "The type of package, corresponding to the service type of the package plugin, e.g. KPackage/Generic, Plasma/Theme, "
-                                      "Plasma/Wallpaper, Plasma/Applet, etc."),
+                                      "Plasma/Wallpaper, Plasma/Applet, etc. Can be given several times with list."),
                                 QStringLiteral("type"),
                                 QStringLiteral("KPackage/Generic")};
     return o;
@@ -37,6 +37,12 @@ static QCommandLineOption install()
                                 QStringLiteral("path")};
     return o;
 }
+static QCommandLineOption installMany()
+{
+    static QCommandLineOption o{QStringList{QStringLiteral("install-many")},
+                                i18nc("Do not translate <path>", "Install the packages at the <path> arguments, several at a time")};
+    return o;
+}
 static QCommandLineOption show()
 {
     static QCommandLineOption o{QStringList{QStringLiteral("s"), QStringLiteral("show")},
@@ -61,6 +67,11 @@ static QCommandLineOption listTypes()
     static QCommandLineOption o{QStringList{QStringLiteral("list-types")}, i18n("List all known package types that can be installed")};
     return o;
 }
+static QCommandLineOption json()
+{
+    static QCommandLineOption o{QStringList{QStringLiteral("json")}, i18n("Print the output of list or list-types as JSON")};
+    return o;
+}
 static QCommandLineOption remove()
 {
     static QCommandLineOption o{QStringList{QStringLiteral("r"), QStringLiteral("remove")},
@@ -68,6 +79,18 @@ static QCommandLineOption remove()
                                 QStringLiteral("name")};
     return o;
 }
+static QCommandLineOption generateIndex()
+{
+    static QCommandLineOption o{QStringList{QStringLiteral("generate-index")},
+                                i18n("Generate the package index shared by all users, for the packages of the given type installed for all users "
+                                     "(with --global) or in the given package root. To be run after installing packages by other means than this tool.")};
+    return o;
+}
+static QCommandLineOption removeIndex()
+{
+    static QCommandLineOption o{QStringList{QStringLiteral("remove-index")}, i18n("Remove the package index shared by all users")};
+    return o;
+}
 static QCommandLineOption packageRoot()
 {
     static QCommandLineOption o{QStringList{QStringLiteral("p"), QStringLiteral("packageroot")},